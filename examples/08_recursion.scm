@@ -24,5 +24,11 @@
 
 (display (fib 8) "\n") ; Should be 21
 
+;; Memoized Fibonacci: rebinding the name makes the recursive calls hit the cache
+
+(define fib (memoize fib))
+(display (fib 80) "\n")
+(display (memo-stats fib) "\n")
+
 ;; eof
 
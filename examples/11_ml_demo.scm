@@ -64,7 +64,11 @@
 ;; --- kmeans ---
 (display "\n--- KMeans clustering (k=2) ---\n")
 (define points (list 1 2 10 12))
-(display (kmeans points 2) "\n") ; cluster centers near 1.5 and 11
+(display (kmeans points 2) "\n") ; (centers assignments), centers near 1.5 and 11
+
+;; n-D points, at most 50 iterations, tolerance 1e-4
+(define points2 (list (list 0 0) (list 0 1) (list 10 10) (list 10 11)))
+(display (car (kmeans points2 2 50 0.0001)) "\n") ; centers near (0 0.5) and (10 10.5)
 
 ;; --- knn ---
 (display "\n--- kNN classification ---\n")
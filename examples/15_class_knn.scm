@@ -118,6 +118,12 @@
 (display "\nCorrect classifications: " correct " out of " total "\n")
 (display "Accuracy: " (/ (* correct 100) total) "%\n")
 
+;; same experiment with a prebuilt index and one batch query
+(define index (knn-index train_x train_y))
+(define batch_predicted (knn-query index test_x 3))
+(display "\nBatch query matches per-sample knn: " (eq? batch_predicted
+  (map (lambda (x) (knn train_x train_y x 3)) test_x)) "\n")
+
 (display "\n=== Experiment completed ===\n")
 
 ;; eof
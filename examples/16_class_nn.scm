@@ -134,26 +134,10 @@
 ;; --- Initialize network ---
 (define net (nn-init (list 4 8 3) (list "relu" "softmax")))
 
-;; --- Training loop with loss reporting ---
-(define epochs 10)
-(define lr 0.05)
-(define i 0)
-
-(while (< i epochs)
-  (begin
-    (define j 0)
-    (define epoch_loss 0)
-    (while (< j (length train_x))
-      (begin
-        (define loss (nn-train net (car (drop j train_x)) (car (drop j train_y_oh)) lr))
-        (set! epoch_loss (+ epoch_loss loss))
-        (set! j (+ j 1))))
-    (display "Epoch ")
-    (display i)
-    (display " | Loss: ")
-    (display (/ epoch_loss (length train_x)))
-    (display "\n")
-    (set! i (+ i 1))))
+;; --- Native training: 100 epochs, mini-batches of 16, Adam, loss printed per epoch ---
+(define epochs 100)
+(define lr 0.01)
+(define losses (nn-fit net train_x train_y_oh epochs lr 16 'adam 1))
 
 (display "Training done!\n")
 
@@ -0,0 +1,30 @@
+(load "stdlib.scm")
+
+(display "\n=== Futures Demo ===\n")
+
+;; --- Prepare a few WAV files
+
+(define files (list "part1.wav" "part2.wav" "part3.wav"))
+(define i 0)
+(while (< i 3)
+  (begin
+    (writewav (vector-ref files i) (list (random-uniform 44100)) 16 44100)
+    (set! i (+ i 1))))
+
+;; --- Process each file while the next one is read in the background
+
+(define next (future (readwav (vector-ref files 0))))
+(define i 0)
+(while (< i 3)
+  (begin
+    (define chans (await next))
+    (if (< (+ i 1) 3) (set! next (future (readwav (vector-ref files (+ i 1))))))
+    (display (vector-ref files i) ": rms " (sqrt (mean (map (lambda (x) (* x x)) (car chans)))) "\n")
+    (set! i (+ i 1))))
+
+;; --- Independent computations can run side by side
+
+(define jobs (map (lambda (n) (future (fold + 0 (range 0 n)))) (list 100 1000 10000)))
+(display "sums: " (await-all jobs) "\n")
+
+(display "\n=== Futures Demo Completed ===\n")
@@ -10,31 +10,598 @@
 #include <fstream>
 #include <algorithm>
 #include <random>
+#include <cstring>
+#include <cstdint>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include <queue>
+#include <limits>
+#include <bit>
+#include <mutex>
+#include <array>
+#include <numeric>
+#include <chrono>
 #include "snip.h"
 
-AtomPtr fn_mean(AtomPtr node, AtomPtr env) {
-    AtomPtr list = type_check(node->tail.at(0), LIST);
-    if (list->tail.empty()) return make_atom(0.0);
-    Real sum = 0;
+// helpers
+unsigned num_threads() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+inline thread_local bool in_parallel = false; // nested regions run serially
+// runs f(begin, end) over contiguous slices of [0, n) on all cores;
+// f must not throw (validate inputs before the parallel region)
+template <typename F>
+void parallel_for(size_t n, size_t grain, F f) {
+    size_t chunks = std::min<size_t>(num_threads(), (n + grain - 1) / std::max<size_t>(grain, 1));
+    if (chunks <= 1 || in_parallel) {
+        if (n) f(0, n);
+        return;
+    }
+    size_t step = (n + chunks - 1) / chunks;
+    std::vector<std::thread> workers;
+    for (size_t b = step; b < n; b += step) {
+        workers.emplace_back([&f, b, n, step] {
+            in_parallel = true;
+            f(b, std::min(n, b + step));
+        });
+    }
+    in_parallel = true;
+    f(0, step);
+    in_parallel = false;
+    for (auto& w : workers) w.join();
+}
+struct Matrix : public Object {
+    static constexpr const char* NAME = "matrix";
+    const char* name() const { return NAME; }
+    void print(std::ostream& out) const {
+        Writer w(out);
+        w.put("<matrix " + std::to_string(rows) + "x" + std::to_string(cols));
+        if (rows * cols <= 64) {
+            w.put(" (");
+            for (size_t i = 0; i < rows; ++i) {
+                w.put(i ? " (" : "(");
+                for (size_t j = 0; j < cols; ++j) {
+                    if (j) w.put(' ');
+                    w.number(data[i * cols + j]);
+                }
+                w.put(')');
+            }
+            w.put(')');
+        }
+        w.put('>');
+    }
+    size_t rows, cols;
+    std::vector<Real> data; // row-major
+    Matrix(size_t r, size_t c, Real fill = 0) : rows(r), cols(c), data(r * c, fill) {}
+    Matrix(size_t r, size_t c, std::vector<Real>&& d) : rows(r), cols(c), data(std::move(d)) {}
+};
+AtomPtr make_matrix(size_t rows, size_t cols, std::vector<Real>&& data) {
+    return make_atom(std::make_shared<Matrix>(rows, cols, std::move(data)));
+}
+bool is_matrix(AtomPtr a) {
+    return a->type == OBJECT && dynamic_cast<Matrix*>(a->obj.get());
+}
+// packed argument values: a matrix (immutable) is borrowed without copying,
+// a list is converted into owned storage; take() yields a mutable vector.
+// Move-only, so p stays valid (a moved vector keeps its buffer)
+struct Packed {
+    std::vector<Real> own;
+    const std::vector<Real>* borrowed = nullptr;
+    const Real* p = nullptr;
+    size_t n = 0;
+    Packed() {}
+    Packed(std::vector<Real>&& v) : own(std::move(v)), p(own.data()), n(own.size()) {}
+    Packed(const std::vector<Real>& v) : borrowed(&v), p(v.data()), n(v.size()) {}
+    Packed(Packed&&) = default;
+    Packed& operator=(Packed&&) = default;
+    const std::vector<Real>& vec() const { return borrowed ? *borrowed : own; }
+    operator const std::vector<Real>&() const { return vec(); }
+    const Real* data() const { return p; }
+    size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+    const Real& operator[](size_t i) const { return p[i]; }
+    const Real* begin() const { return p; }
+    const Real* end() const { return p + n; }
+    std::vector<Real> take() { return borrowed ? *borrowed : std::move(own); }
+};
+// matrix, list of numbers (one column) or list of rows, packed row-major
+Packed pack_rows(AtomPtr list, size_t& rows, size_t& cols, AtomPtr node) {
+    if (list->type == OBJECT) {
+        Matrix* m = object_check<Matrix>(list);
+        rows = m->rows;
+        cols = m->cols;
+        return Packed(m->data);
+    }
+    type_check(list, LIST);
+    bool is_1d = list->tail.size() > 0 && list->tail.at(0)->type == NUMBER;
+    rows = list->tail.size();
+    cols = is_1d ? 1 : (rows ? type_check(list->tail.at(0), LIST)->tail.size() : 0);
+    std::vector<Real> data(rows * cols);
+    Real* p = data.data();
     for (auto& e : list->tail) {
-        sum += type_check(e, NUMBER)->value;
+        if (is_1d) {
+            *p++ = type_check(e, NUMBER)->value;
+            continue;
+        }
+        AtomPtr row = type_check(e, LIST);
+        if (row->tail.size() != cols) error("all rows must have same length", node);
+        for (auto& v : row->tail) *p++ = type_check(v, NUMBER)->value;
+    }
+    return data;
+}
+// list of numbers or matrix (all elements, row-major)
+Packed pack_vector(AtomPtr list, AtomPtr node) {
+    if (list->type == OBJECT) return Packed(object_check<Matrix>(list)->data);
+    type_check(list, LIST);
+    std::vector<Real> data(list->tail.size());
+    for (size_t i = 0; i < data.size(); ++i) data[i] = type_check(list->tail[i], NUMBER)->value;
+    return data;
+}
+AtomPtr unpack_rows(const Real* data, size_t rows, size_t cols) {
+    AtomPtr result = make_atom();
+    result->tail.reserve(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        AtomPtr row = make_atom();
+        row->tail.reserve(cols);
+        for (size_t j = 0; j < cols; ++j) row->tail.push_back(make_atom(data[i * cols + j]));
+        result->tail.push_back(row);
+    }
+    return result;
+}
+AtomPtr unpack_vector(const Real* data, size_t n) {
+    AtomPtr result = make_atom();
+    result->tail.reserve(n);
+    for (size_t i = 0; i < n; ++i) result->tail.push_back(make_atom(data[i]));
+    return result;
+}
+Real dot_product(const Real* a, const Real* b, size_t n) {
+    Real sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    size_t i = 0;
+    // process blocks of 4
+    for (; i + 3 < n; i += 4) {
+        sum0 += a[i+0] * b[i+0];
+        sum1 += a[i+1] * b[i+1];
+        sum2 += a[i+2] * b[i+2];
+        sum3 += a[i+3] * b[i+3];
+    }
+    for (; i < n; ++i) {
+        sum0 += a[i] * b[i];
+    }
+    return sum0 + sum1 + sum2 + sum3;
+}
+// bulk random fill: fixed-size blocks each draw from their own substream
+// (the caller's generator jumped once per block), so the values do not
+// depend on the number of threads; the caller resumes after the last block
+enum Distribution {UNIFORM, NORMAL, INTEGER};
+void random_fill(Real* out, size_t n, Distribution dist, Real a, Real b) {
+    const size_t block = 1 << 16;
+    size_t blocks = (n + block - 1) / block;
+    Xoshiro256& gen = rng();
+    std::vector<Xoshiro256> streams;
+    streams.reserve(blocks);
+    for (size_t i = 0; i < blocks; ++i) {
+        streams.push_back(gen);
+        gen.jump();
+    }
+    parallel_for(blocks, 1, [&](size_t b0, size_t b1) {
+        for (size_t blk = b0; blk < b1; ++blk) {
+            Xoshiro256& g = streams[blk];
+            Real* x = out + blk * block;
+            size_t m = std::min(block, n - blk * block);
+            if (dist == UNIFORM) {
+                for (size_t i = 0; i < m; ++i) x[i] = a + (b - a) * g.uniform();
+            } else if (dist == INTEGER) {
+                uint64_t range = (uint64_t) (b - a) + 1;
+                for (size_t i = 0; i < m; ++i) x[i] = a + (Real) g.below(range);
+            } else {
+                for (size_t i = 0; i < m; i += 2) { // Box-Muller, two values per pair
+                    Real r = std::sqrt(-2 * std::log(1 - g.uniform())), t = 2 * M_PI * g.uniform();
+                    x[i] = a + b * r * std::cos(t);
+                    if (i + 1 < m) x[i + 1] = a + b * r * std::sin(t);
+                }
+            }
+        }
+    });
+}
+// (random-uniform n [lo hi]), (random-normal n [mean stddev]), (random-int n lo hi);
+// n can also be a (rows cols) shape to get a matrix
+AtomPtr random_values(AtomPtr node, Distribution dist, Real a, Real b) {
+    AtomPtr shape = node->tail.at(0);
+    size_t rows = 1, cols;
+    if (shape->type == LIST) {
+        if (shape->tail.size() != 2) error("shape must be (rows cols)", node);
+        rows = (size_t) std::max<Real>(0, type_check(shape->tail.at(0), NUMBER)->value);
+        cols = (size_t) std::max<Real>(0, type_check(shape->tail.at(1), NUMBER)->value);
+    } else {
+        Real n = type_check(shape, NUMBER)->value;
+        if (n < 0) error("number of samples must be non-negative", node);
+        cols = (size_t) n;
+    }
+    std::vector<Real> data(rows * cols);
+    random_fill(data.data(), data.size(), dist, a, b);
+    if (shape->type == LIST) return make_matrix(rows, cols, std::move(data));
+    return unpack_vector(data.data(), data.size());
+}
+AtomPtr fn_random_uniform(AtomPtr node, AtomPtr env) {
+    Real lo = node->tail.size() > 1 ? type_check(node->tail.at(1), NUMBER)->value : 0;
+    Real hi = node->tail.size() > 2 ? type_check(node->tail.at(2), NUMBER)->value : 1;
+    return random_values(node, UNIFORM, lo, hi);
+}
+AtomPtr fn_random_normal(AtomPtr node, AtomPtr env) {
+    Real mean = node->tail.size() > 1 ? type_check(node->tail.at(1), NUMBER)->value : 0;
+    Real sd = node->tail.size() > 2 ? type_check(node->tail.at(2), NUMBER)->value : 1;
+    if (sd < 0) error("standard deviation must be non-negative", node);
+    return random_values(node, NORMAL, mean, sd);
+}
+AtomPtr fn_random_int(AtomPtr node, AtomPtr env) {
+    Real lo = std::ceil(type_check(node->tail.at(1), NUMBER)->value);
+    Real hi = std::floor(type_check(node->tail.at(2), NUMBER)->value);
+    if (hi < lo) error("empty integer range", node);
+    return random_values(node, INTEGER, lo, hi);
+}
+// micro-kernel: a MR x NR tile of C accumulated in registers over a packed
+// MR-row panel of A and NR-column panel of B
+const size_t GEMM_MR = 4, GEMM_NR = 4, GEMM_MC = 64, GEMM_KC = 256, GEMM_NC = 512;
+inline void gemm_kernel(size_t kc, const Real* a, const Real* b, Real* c, size_t ldc, size_t mr, size_t nr) {
+    Real acc[GEMM_MR][GEMM_NR] = {};
+    for (size_t p = 0; p < kc; ++p, a += GEMM_MR, b += GEMM_NR) {
+        for (size_t i = 0; i < GEMM_MR; ++i) {
+            for (size_t j = 0; j < GEMM_NR; ++j) acc[i][j] += a[i] * b[j];
+        }
+    }
+    for (size_t i = 0; i < mr; ++i) {
+        for (size_t j = 0; j < nr; ++j) c[i * ldc + j] += acc[i][j];
+    }
+}
+// C = alpha * op(A) * op(B) + beta * C on row-major buffers, where op(A) is
+// M x K and op(B) is K x N; blocked for cache (KC x NC panels of B, MC x KC
+// blocks of A, both packed and zero-padded) and split across threads by rows of C
+void gemm(bool trans_a, bool trans_b, size_t M, size_t N, size_t K, Real alpha,
+    const Real* A, const Real* B, Real beta, Real* C) {
+    size_t ars = trans_a ? 1 : K, acs = trans_a ? M : 1;
+    size_t brs = trans_b ? 1 : N, bcs = trans_b ? K : 1;
+    size_t grain = std::max<size_t>(GEMM_MC, (1 << 16) / std::max<size_t>(N * K, 1));
+    parallel_for(M, grain, [&](size_t m0, size_t m1) {
+        for (size_t i = m0; i < m1; ++i) {
+            for (size_t j = 0; j < N; ++j) C[i * N + j] = beta == 0 ? 0 : beta * C[i * N + j];
+        }
+        if (K == 0 || alpha == 0) return;
+        std::vector<Real> pa(GEMM_MC * GEMM_KC), pb(GEMM_KC * (GEMM_NC + GEMM_NR));
+        for (size_t jc = 0; jc < N; jc += GEMM_NC) {
+            size_t nc = std::min(GEMM_NC, N - jc);
+            for (size_t pc = 0; pc < K; pc += GEMM_KC) {
+                size_t kc = std::min(GEMM_KC, K - pc);
+                for (size_t jp = 0; jp < nc; jp += GEMM_NR) {
+                    Real* dst = &pb[jp * kc];
+                    for (size_t p = 0; p < kc; ++p) {
+                        for (size_t jj = 0; jj < GEMM_NR; ++jj) {
+                            size_t j = jc + jp + jj;
+                            *dst++ = j < jc + nc ? B[(pc + p) * brs + j * bcs] : 0;
+                        }
+                    }
+                }
+                for (size_t ic = m0; ic < m1; ic += GEMM_MC) {
+                    size_t mc = std::min(GEMM_MC, m1 - ic);
+                    for (size_t ip = 0; ip < mc; ip += GEMM_MR) {
+                        Real* dst = &pa[ip * kc];
+                        for (size_t p = 0; p < kc; ++p) {
+                            for (size_t ii = 0; ii < GEMM_MR; ++ii) {
+                                size_t i = ic + ip + ii;
+                                *dst++ = i < ic + mc ? alpha * A[i * ars + (pc + p) * acs] : 0;
+                            }
+                        }
+                    }
+                    for (size_t jp = 0; jp < nc; jp += GEMM_NR) {
+                        for (size_t ip = 0; ip < mc; ip += GEMM_MR) {
+                            gemm_kernel(kc, &pa[ip * kc], &pb[jp * kc], C + (ic + ip) * N + jc + jp, N,
+                                std::min(GEMM_MR, mc - ip), std::min(GEMM_NR, nc - jp));
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+// ((key value) ...) association list of named numbers
+AtomPtr make_record(std::initializer_list<std::pair<const char*, Real>> fields) {
+    AtomPtr result = make_atom();
+    for (auto& f : fields) {
+        AtomPtr entry = make_atom();
+        entry->tail.push_back(make_atom(std::string(f.first)));
+        entry->tail.push_back(make_atom(f.second));
+        result->tail.push_back(entry);
     }
-    return make_atom(sum / list->tail.size());
+    return result;
+}
+// running moments (Welford / Pebay): blocks can be pushed incrementally and
+// accumulators from different chunks or threads merged exactly
+struct Stats : public Object {
+    static constexpr const char* NAME = "stats";
+    const char* name() const { return NAME; }
+    void print(std::ostream& out) const {
+        Writer w(out);
+        w.put("<stats n=");
+        w.number(n);
+        w.put(" mean=");
+        w.number(mean);
+        w.put('>');
+    }
+    Real n = 0, mean = 0, M2 = 0, M3 = 0, M4 = 0;
+    Real min = std::numeric_limits<Real>::infinity(), max = -std::numeric_limits<Real>::infinity();
+    void push(Real x) {
+        Real n1 = n++;
+        Real delta = x - mean, delta_n = delta / n, delta_n2 = delta_n * delta_n;
+        Real term = delta * delta_n * n1;
+        mean += delta_n;
+        M4 += term * delta_n2 * (n * n - 3 * n + 3) + 6 * delta_n2 * M2 - 4 * delta_n * M3;
+        M3 += term * delta_n * (n - 2) - 3 * delta_n * M2;
+        M2 += term;
+        min = std::min(min, x);
+        max = std::max(max, x);
+    }
+    void merge(const Stats& b) {
+        if (b.n == 0) return;
+        if (n == 0) {
+            *this = b;
+            return;
+        }
+        Real na = n, nb = b.n, nn = na + nb;
+        Real delta = b.mean - mean, d2 = delta * delta, d3 = d2 * delta, d4 = d2 * d2;
+        Real m2 = M2 + b.M2 + d2 * na * nb / nn;
+        Real m3 = M3 + b.M3 + d3 * na * nb * (na - nb) / (nn * nn)
+            + 3 * delta * (na * b.M2 - nb * M2) / nn;
+        Real m4 = M4 + b.M4 + d4 * na * nb * (na * na - na * nb + nb * nb) / (nn * nn * nn)
+            + 6 * d2 * (na * na * b.M2 + nb * nb * M2) / (nn * nn)
+            + 4 * delta * (na * b.M3 - nb * M3) / nn;
+        mean += delta * nb / nn;
+        M2 = m2;
+        M3 = m3;
+        M4 = m4;
+        n = nn;
+        min = std::min(min, b.min);
+        max = std::max(max, b.max);
+    }
+    // fixed-size blocks reduced in parallel and merged in order, so the
+    // result does not depend on the number of threads
+    void push(const Real* x, size_t count) {
+        const size_t block = 1 << 14;
+        size_t blocks = (count + block - 1) / block;
+        std::vector<Stats> partial(blocks);
+        parallel_for(blocks, 1, [&](size_t b0, size_t b1) {
+            for (size_t b = b0; b < b1; ++b) {
+                for (size_t i = b * block; i < std::min(count, (b + 1) * block); ++i) partial[b].push(x[i]);
+            }
+        });
+        for (auto& p : partial) merge(p);
+    }
+    Real variance() const { return n > 1 ? M2 / n : 0; }
+};
+// stats object, number, list of numbers or matrix
+void stats_push(Stats& st, AtomPtr data, AtomPtr node) {
+    if (data->type == NUMBER) st.push(data->value);
+    else if (data->type == OBJECT && dynamic_cast<Stats*>(data->obj.get())) st.merge(*object_check<Stats>(data));
+    else {
+        Packed v = pack_vector(data, node);
+        st.push(v.data(), v.size());
+    }
+}
+Stats collect_stats(AtomPtr data, AtomPtr node) {
+    Stats st;
+    stats_push(st, data, node);
+    return st;
+}
+AtomPtr fn_mean(AtomPtr node, AtomPtr env) {
+    return make_atom(collect_stats(node->tail.at(0), node).mean);
 }
 AtomPtr fn_variance(AtomPtr node, AtomPtr env) {
-    AtomPtr list = type_check(node->tail.at(0), LIST);
-    if (list->tail.size() <= 1) return make_atom(0.0);
-    Real m = type_check(fn_mean(node, env), NUMBER)->value;
-    Real var = 0;
+    return make_atom(collect_stats(node->tail.at(0), node).variance());
+}
+AtomPtr fn_stddev(AtomPtr node, AtomPtr env) {
+    return make_atom(std::sqrt(collect_stats(node->tail.at(0), node).variance()));
+}
+AtomPtr fn_stats_new(AtomPtr node, AtomPtr env) {
+    auto st = std::make_shared<Stats>();
+    for (auto& e : node->tail) stats_push(*st, e, node);
+    return make_atom(st);
+}
+// accumulates in place and returns the same object
+AtomPtr fn_stats_push(AtomPtr node, AtomPtr env) {
+    Stats* st = object_check<Stats>(node->tail.at(0));
+    for (size_t i = 1; i < node->tail.size(); ++i) stats_push(*st, node->tail[i], node);
+    return node->tail.at(0);
+}
+AtomPtr fn_stats_merge(AtomPtr node, AtomPtr env) {
+    auto st = std::make_shared<Stats>();
+    for (auto& e : node->tail) st->merge(*object_check<Stats>(e));
+    return make_atom(st);
+}
+// ((count n) (mean m) (variance v) (stddev s) (min a) (max b) (skewness g1) (kurtosis g2))
+// with population moments and excess kurtosis
+AtomPtr fn_describe(AtomPtr node, AtomPtr env) {
+    Stats st = collect_stats(node->tail.at(0), node);
+    Real skew = st.M2 > 0 ? std::sqrt(st.n) * st.M3 / std::pow(st.M2, 1.5) : 0;
+    Real kurt = st.M2 > 0 ? st.n * st.M4 / (st.M2 * st.M2) - 3 : 0;
+    return make_record({{"count", st.n}, {"mean", st.mean},
+        {"variance", st.variance()}, {"stddev", std::sqrt(st.variance())},
+        {"min", st.n ? st.min : 0}, {"max", st.n ? st.max : 0}, {"skewness", skew}, {"kurtosis", kurt}});
+}
+// sorts v by less with ties kept in input order: fixed chunks are sorted
+// in parallel, then merged pairwise level by level
+template <typename T, typename Less>
+void parallel_sort(std::vector<T>& v, Less less) {
+    const size_t chunk = 1 << 15;
+    size_t n = v.size();
+    if (n <= chunk || num_threads() == 1) {
+        std::stable_sort(v.begin(), v.end(), less);
+        return;
+    }
+    size_t chunks = (n + chunk - 1) / chunk;
+    parallel_for(chunks, 1, [&](size_t b, size_t e) {
+        for (size_t c = b; c < e; ++c) {
+            std::stable_sort(v.begin() + c * chunk, v.begin() + std::min(n, (c + 1) * chunk), less);
+        }
+    });
+    std::vector<T> buf(n);
+    for (size_t width = chunk; width < n; width *= 2) {
+        size_t pairs = (n + 2 * width - 1) / (2 * width);
+        parallel_for(pairs, 1, [&](size_t b, size_t e) {
+            for (size_t p = b; p < e; ++p) {
+                size_t lo = p * 2 * width, mid = std::min(n, lo + width), hi = std::min(n, lo + 2 * width);
+                std::merge(v.begin() + lo, v.begin() + mid, v.begin() + mid, v.begin() + hi, buf.begin() + lo, less);
+            }
+        });
+        v.swap(buf);
+    }
+}
+// permutation that sorts the list: numbers compare natively, strings and
+// symbols lexicographically, anything else needs a Scheme less-than predicate
+std::vector<size_t> sort_order(AtomPtr node, AtomPtr env) {
+    AtomPtr list = node->tail.at(0);
+    if (is_matrix(list)) {
+        Packed v = pack_vector(list, node);
+        list = unpack_vector(v.data(), v.size());
+    }
+    type_check(list, LIST);
+    size_t n = list->tail.size();
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; ++i) order[i] = i;
+    if (node->tail.size() > 1) { // user predicate: serial, it runs Scheme code
+        AtomPtr less = node->tail.at(1);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return type_check(call(less, {list->tail[a], list->tail[b]}, env), NUMBER)->value != 0;
+        });
+        return order;
+    }
+    bool numbers = true, strings = true;
     for (auto& e : list->tail) {
-        Real diff = type_check(e, NUMBER)->value - m;
-        var += diff * diff;
+        numbers = numbers && e->type == NUMBER;
+        strings = strings && (e->type == STRING || e->type == SYMBOL);
     }
-    return make_atom(var / (list->tail.size()));
+    if (numbers) {
+        std::vector<std::pair<Real, size_t>> keys(n);
+        for (size_t i = 0; i < n; ++i) keys[i] = {list->tail[i]->value, i};
+        parallel_sort(keys, [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (size_t i = 0; i < n; ++i) order[i] = keys[i].second;
+    } else if (strings) {
+        parallel_sort(order, [&](size_t a, size_t b) { return list->tail[a]->lexeme < list->tail[b]->lexeme; });
+    } else error("sort needs numbers, strings or a comparison function", node);
+    return order;
 }
-AtomPtr fn_stddev(AtomPtr node, AtomPtr env) {
-    AtomPtr var = fn_variance(node, env);
-    return make_atom(std::sqrt(type_check(var, NUMBER)->value));
+AtomPtr fn_sort(AtomPtr node, AtomPtr env) {
+    std::vector<size_t> order = sort_order(node, env);
+    AtomPtr list = node->tail.at(0);
+    if (is_matrix(list)) {
+        Packed v = pack_vector(list, node);
+        std::vector<Real> sorted(v.size());
+        for (size_t i = 0; i < v.size(); ++i) sorted[i] = v[order[i]];
+        return unpack_vector(sorted.data(), sorted.size());
+    }
+    AtomPtr result = make_atom();
+    result->tail.reserve(order.size());
+    for (size_t i : order) result->tail.push_back(list->tail[i]);
+    return result;
+}
+AtomPtr fn_argsort(AtomPtr node, AtomPtr env) {
+    std::vector<size_t> order = sort_order(node, env);
+    AtomPtr result = make_atom();
+    result->tail.reserve(order.size());
+    for (size_t i : order) result->tail.push_back(make_atom((Real) i));
+    return result;
+}
+// order statistics by selection on a packed copy (O(n) per quantile);
+// quantiles interpolate linearly between closest ranks
+Real select_quantile(std::vector<Real>& v, size_t lo, Real p) {
+    Real h = (v.size() - 1) * p;
+    size_t k = (size_t) h;
+    std::nth_element(v.begin() + lo, v.begin() + k, v.end());
+    Real q = v[k];
+    if (k + 1 < v.size() && h > k) q += (h - k) * (*std::min_element(v.begin() + k + 1, v.end()) - q);
+    return q;
+}
+AtomPtr fn_median(AtomPtr node, AtomPtr env) {
+    std::vector<Real> v = pack_vector(node->tail.at(0), node).take(); // selected in place
+    if (v.empty()) error("median of empty data", node);
+    return make_atom(select_quantile(v, 0, 0.5));
+}
+AtomPtr fn_quantile(AtomPtr node, AtomPtr env) {
+    std::vector<Real> v = pack_vector(node->tail.at(0), node).take(); // selected in place
+    if (v.empty()) error("quantile of empty data", node);
+    AtomPtr arg = node->tail.at(1);
+    std::vector<Real> ps = arg->type == NUMBER ? std::vector<Real>{arg->value} : pack_vector(arg, node).take();
+    for (Real p : ps) if (!(p >= 0 && p <= 1)) error("quantile must be in [0, 1]", node);
+    // ascending probabilities select in shrinking suffixes of the buffer
+    std::vector<size_t> order(ps.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return ps[a] < ps[b]; });
+    std::vector<Real> qs(ps.size());
+    size_t lo = 0;
+    for (size_t i : order) {
+        qs[i] = select_quantile(v, lo, ps[i]);
+        lo = (size_t) ((v.size() - 1) * ps[i]);
+    }
+    if (arg->type == NUMBER) return make_atom(qs[0]);
+    return unpack_vector(qs.data(), qs.size());
+}
+AtomPtr fn_minmax(AtomPtr node, AtomPtr env) {
+    Packed v = pack_vector(node->tail.at(0), node);
+    if (v.empty()) error("minmax of empty data", node);
+    auto mm = std::minmax_element(v.begin(), v.end());
+    Real r[2] = {*mm.first, *mm.second};
+    return unpack_vector(r, 2);
+}
+// (histogram data bins [lo hi]) or (histogram data edges) -> (counts edges);
+// bins are half-open except the last one, values outside are dropped
+AtomPtr fn_histogram(AtomPtr node, AtomPtr env) {
+    Packed v = pack_vector(node->tail.at(0), node);
+    AtomPtr arg = node->tail.at(1);
+    std::vector<Real> edges;
+    bool uniform = arg->type == NUMBER;
+    if (uniform) {
+        int bins = (int) arg->value;
+        if (bins < 1) error("histogram needs at least one bin", node);
+        Real lo, hi;
+        if (node->tail.size() > 3) {
+            lo = type_check(node->tail.at(2), NUMBER)->value;
+            hi = type_check(node->tail.at(3), NUMBER)->value;
+        } else if (v.size()) {
+            auto mm = std::minmax_element(v.begin(), v.end());
+            lo = *mm.first;
+            hi = *mm.second;
+        } else lo = 0, hi = 1;
+        if (hi == lo) hi = lo + 1;
+        if (!(hi > lo)) error("histogram range must be increasing", node);
+        for (int i = 0; i <= bins; ++i) edges.push_back(lo + (hi - lo) * i / bins);
+    } else {
+        edges = pack_vector(arg, node).take();
+        if (edges.size() < 2) error("histogram needs at least two edges", node);
+        for (size_t i = 1; i < edges.size(); ++i) {
+            if (!(edges[i] > edges[i - 1])) error("histogram edges must be increasing", node);
+        }
+    }
+    size_t bins = edges.size() - 1;
+    Real lo = edges.front(), hi = edges.back(), scale = bins / (hi - lo);
+    std::vector<Real> counts(bins, 0);
+    std::mutex lock;
+    parallel_for(v.size(), 1 << 15, [&](size_t b, size_t e) {
+        std::vector<size_t> local(bins, 0);
+        for (size_t i = b; i < e; ++i) {
+            Real x = v[i];
+            if (!(x >= lo && x <= hi)) continue;
+            size_t k = uniform ? (size_t) ((x - lo) * scale)
+                : std::upper_bound(edges.begin(), edges.end(), x) - edges.begin() - 1;
+            ++local[std::min(k, bins - 1)];
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        for (size_t k = 0; k < bins; ++k) counts[k] += local[k];
+    });
+    AtomPtr result = make_atom();
+    result->tail.push_back(unpack_vector(counts.data(), bins));
+    result->tail.push_back(unpack_vector(edges.data(), edges.size()));
+    return result;
 }
 AtomPtr fn_distance(AtomPtr node, AtomPtr env) {
     AtomPtr a = type_check(node->tail.at(0), LIST);
@@ -47,72 +614,235 @@ AtomPtr fn_distance(AtomPtr node, AtomPtr env) {
     }
     return make_atom(std::sqrt(sum));
 }
-AtomPtr fn_linear_regression(AtomPtr node, AtomPtr env) {
-    AtomPtr x_list = type_check(node->tail.at(0), LIST);
-    AtomPtr y_list = type_check(node->tail.at(1), LIST);
-    if (x_list->tail.size() != y_list->tail.size())
-        error("linear-regression: x and y must have same length", node);
-    size_t n = x_list->tail.size();
-    bool is_1d = x_list->tail.size() > 0 && x_list->tail.at(0)->type == NUMBER;
-    size_t dim = is_1d ? 1 : type_check(x_list->tail.at(0), LIST)->tail.size();
-    size_t dim_b = dim + 1; // bias term
-    // build XtX matrix (dim_b × dim_b)
-    std::vector<std::vector<Real>> XtX(dim_b, std::vector<Real>(dim_b, 0.0));
-    // build XtY vector (dim_b)
-    std::vector<Real> XtY(dim_b, 0.0);
+enum Metric {EUCLIDEAN, SQEUCLIDEAN, COSINE, MANHATTAN};
+Metric metric_arg(AtomPtr node, size_t pos) {
+    if (node->tail.size() <= pos) return EUCLIDEAN;
+    std::string m = type_check(node->tail.at(pos), SYMBOL)->lexeme;
+    if (m == "euclidean") return EUCLIDEAN;
+    if (m == "sqeuclidean") return SQEUCLIDEAN;
+    if (m == "cosine") return COSINE;
+    if (m == "manhattan") return MANHATTAN;
+    error("metric must be euclidean, sqeuclidean, cosine or manhattan", node);
+    return EUCLIDEAN; // dummy
+}
+// D (n x m) between the rows of X and Y; inner-product metrics go through
+// the blocked gemm (|x|^2 + |y|^2 - 2 x.y), manhattan through row tiles
+void distance_matrix(const Real* X, size_t n, const Real* Y, size_t m, size_t dim, Metric metric, Real* D) {
+    if (metric == MANHATTAN) {
+        const size_t T = 64; // rows of Y reused from cache for each row of X
+        parallel_for(n, 16, [&](size_t b, size_t e) {
+            for (size_t j0 = 0; j0 < m; j0 += T) {
+                for (size_t i = b; i < e; ++i) {
+                    for (size_t j = j0; j < std::min(m, j0 + T); ++j) {
+                        Real sum = 0;
+                        for (size_t d = 0; d < dim; ++d) sum += std::abs(X[i * dim + d] - Y[j * dim + d]);
+                        D[i * m + j] = sum;
+                    }
+                }
+            }
+        });
+        return;
+    }
+    gemm(false, true, n, m, dim, 1.0, X, Y, 0.0, D);
+    std::vector<Real> nx(n), ny(m);
+    for (size_t i = 0; i < n; ++i) nx[i] = dot_product(&X[i * dim], &X[i * dim], dim);
+    for (size_t j = 0; j < m; ++j) ny[j] = dot_product(&Y[j * dim], &Y[j * dim], dim);
+    parallel_for(n, 64, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i) {
+            Real* row = &D[i * m];
+            for (size_t j = 0; j < m; ++j) {
+                if (metric == COSINE) {
+                    Real norm = std::sqrt(nx[i] * ny[j]);
+                    row[j] = norm > 0 ? 1 - row[j] / norm : 1;
+                } else {
+                    Real d2 = std::max<Real>(0, nx[i] + ny[j] - 2 * row[j]);
+                    row[j] = metric == EUCLIDEAN ? std::sqrt(d2) : d2;
+                }
+            }
+        }
+    });
+}
+// (cdist X Y [metric]) -> n x m matrix of distances between rows
+AtomPtr fn_cdist(AtomPtr node, AtomPtr env) {
+    size_t n = 0, m = 0, dx = 0, dy = 0;
+    Packed X = pack_rows(node->tail.at(0), n, dx, node);
+    Packed Y = pack_rows(node->tail.at(1), m, dy, node);
+    if (dx != dy) error("dimension mismatch", node);
+    std::vector<Real> D(n * m);
+    distance_matrix(X.data(), n, Y.data(), m, dx, metric_arg(node, 2), D.data());
+    return make_matrix(n, m, std::move(D));
+}
+// (pdist X [metric]) -> symmetric n x n matrix with an exact zero diagonal
+AtomPtr fn_pdist(AtomPtr node, AtomPtr env) {
+    size_t n = 0, dim = 0;
+    Packed X = pack_rows(node->tail.at(0), n, dim, node);
+    std::vector<Real> D(n * n);
+    distance_matrix(X.data(), n, X.data(), n, dim, metric_arg(node, 1), D.data());
     for (size_t i = 0; i < n; ++i) {
-        std::vector<Real> xi(dim_b, 1.0); // bias first
-        if (is_1d) {
-            xi[1] = type_check(x_list->tail.at(i), NUMBER)->value;
-        } else {
-            AtomPtr row = type_check(x_list->tail.at(i), LIST);
-            for (size_t j = 0; j < dim; ++j) {
-                xi[j+1] = type_check(row->tail.at(j), NUMBER)->value;
-            }
-        }
-        Real yi = type_check(y_list->tail.at(i), NUMBER)->value;
-        for (size_t j = 0; j < dim_b; ++j) {
-            for (size_t k = 0; k < dim_b; ++k) {
-                XtX[j][k] += xi[j] * xi[k];
-            }
-            XtY[j] += xi[j] * yi;
-        }
-    }
-    // solve (XtX) w = XtY
-    std::vector<std::vector<Real>> inv(dim_b, std::vector<Real>(dim_b, 0.0));
-    if (dim_b == 2) {
-        Real det = XtX[0][0]*XtX[1][1] - XtX[0][1]*XtX[1][0];
-        if (std::abs(det) < 1e-8) error("singular matrix in regression", node);
-        inv[0][0] =  XtX[1][1] / det;
-        inv[0][1] = -XtX[0][1] / det;
-        inv[1][0] = -XtX[1][0] / det;
-        inv[1][1] =  XtX[0][0] / det;
-    } else if (dim_b == 3) {
-        Real a = XtX[0][0], b = XtX[0][1], c = XtX[0][2];
-        Real d = XtX[1][0], e = XtX[1][1], f = XtX[1][2];
-        Real g = XtX[2][0], h = XtX[2][1], i = XtX[2][2];
-        Real det = a*(e*i - f*h) - b*(d*i - f*g) + c*(d*h - e*g);
-        if (std::abs(det) < 1e-8) error("singular matrix in regression", node);
-        inv[0][0] = (e*i - f*h) / det;
-        inv[0][1] = (c*h - b*i) / det;
-        inv[0][2] = (b*f - c*e) / det;
-        inv[1][0] = (f*g - d*i) / det;
-        inv[1][1] = (a*i - c*g) / det;
-        inv[1][2] = (c*d - a*f) / det;
-        inv[2][0] = (d*h - e*g) / det;
-        inv[2][1] = (b*g - a*h) / det;
-        inv[2][2] = (a*e - b*d) / det;
-    } else {
-        error("linear regression currently supports up to 2 features", node);
+        D[i * n + i] = 0;
+        for (size_t j = 0; j < i; ++j) D[i * n + j] = D[j * n + i];
     }
-    // w = inv(XtX) * XtY
-    std::vector<Real> w(dim_b, 0.0);
-    for (size_t j = 0; j < dim_b; ++j) {
-        for (size_t k = 0; k < dim_b; ++k) {
-            w[j] += inv[j][k] * XtY[k];
+    return make_matrix(n, n, std::move(D));
+}
+// Cholesky factorization in place (lower triangle); false if A is not
+// numerically positive definite or too ill-conditioned to trust
+bool cholesky(std::vector<Real>& A, size_t n) {
+    Real dmin = std::numeric_limits<Real>::max(), dmax = 0;
+    for (size_t j = 0; j < n; ++j) {
+        Real d = A[j * n + j];
+        for (size_t k = 0; k < j; ++k) d -= A[j * n + k] * A[j * n + k];
+        if (!(d > 0)) return false;
+        d = std::sqrt(d);
+        A[j * n + j] = d;
+        dmin = std::min(dmin, d);
+        dmax = std::max(dmax, d);
+        for (size_t i = j + 1; i < n; ++i) {
+            Real v = A[i * n + j];
+            for (size_t k = 0; k < j; ++k) v -= A[i * n + k] * A[j * n + k];
+            A[i * n + j] = v / d;
         }
     }
-    // --- corrected model output ---
+    return dmax / dmin < 1e6; // condition number of A below ~1e12
+}
+std::vector<Real> cholesky_solve(const std::vector<Real>& L, size_t n, std::vector<Real> b) {
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t k = 0; k < i; ++k) b[i] -= L[i * n + k] * b[k];
+        b[i] /= L[i * n + i];
+    }
+    for (size_t i = n; i-- > 0;) {
+        for (size_t k = i + 1; k < n; ++k) b[i] -= L[k * n + i] * b[k];
+        b[i] /= L[i * n + i];
+    }
+    return b;
+}
+// least squares min |Ax - b| (A is m x n) by Householder QR with column pivoting;
+// columns beyond the numerical rank get a zero coefficient
+std::vector<Real> qr_solve(std::vector<Real> A, size_t m, size_t n, std::vector<Real> b) {
+    std::vector<size_t> perm(n);
+    for (size_t j = 0; j < n; ++j) perm[j] = j;
+    size_t rank = 0;
+    Real r0 = 0;
+    for (size_t k = 0; k < std::min(m, n); ++k) {
+        size_t p = k;
+        Real best = -1;
+        for (size_t j = k; j < n; ++j) {
+            Real norm = 0;
+            for (size_t i = k; i < m; ++i) norm += A[i * n + j] * A[i * n + j];
+            if (norm > best) {
+                best = norm;
+                p = j;
+            }
+        }
+        if (p != k) {
+            for (size_t i = 0; i < m; ++i) std::swap(A[i * n + k], A[i * n + p]);
+            std::swap(perm[k], perm[p]);
+        }
+        Real norm = std::sqrt(best);
+        if (k == 0) r0 = norm;
+        if (norm <= 1e-10 * r0 || norm == 0) break;
+        Real alpha = A[k * n + k] > 0 ? -norm : norm;
+        std::vector<Real> v(m - k);
+        for (size_t i = k; i < m; ++i) v[i - k] = A[i * n + k];
+        v[0] -= alpha;
+        Real vv = 0;
+        for (Real e : v) vv += e * e;
+        for (size_t j = k + 1; j < n; ++j) {
+            Real dot = 0;
+            for (size_t i = k; i < m; ++i) dot += v[i - k] * A[i * n + j];
+            Real f = 2 * dot / vv;
+            for (size_t i = k; i < m; ++i) A[i * n + j] -= f * v[i - k];
+        }
+        Real dot = 0;
+        for (size_t i = k; i < m; ++i) dot += v[i - k] * b[i];
+        Real f = 2 * dot / vv;
+        for (size_t i = k; i < m; ++i) b[i] -= f * v[i - k];
+        A[k * n + k] = alpha;
+        rank = k + 1;
+    }
+    std::vector<Real> z(rank), x(n, 0.0);
+    for (size_t i = rank; i-- > 0;) {
+        Real v = b[i];
+        for (size_t j = i + 1; j < rank; ++j) v -= A[i * n + j] * z[j];
+        z[i] = v / A[i * n + i];
+    }
+    for (size_t i = 0; i < rank; ++i) x[perm[i]] = z[i];
+    return x;
+}
+// normal equations of a linear model with the bias as first coefficient
+struct LinregAcc : public Object {
+    static constexpr const char* NAME = "linreg-acc";
+    const char* name() const { return NAME; }
+    void print(std::ostream& out) const {
+        out << "<linreg-acc " << rows << " rows, " << dim << " features>";
+    }
+    size_t dim, rows;
+    std::vector<Real> XtX, XtY; // (dim + 1)^2 and dim + 1
+
+    LinregAcc(size_t d) : dim(d), rows(0), XtX((d + 1) * (d + 1), 0.0), XtY(d + 1, 0.0) {}
+    // rows are split into a fixed number of groups summed in order, so the
+    // result is the same whatever the number of threads
+    void accumulate(const std::vector<Real>& X, const std::vector<Real>& y) {
+        size_t n = y.size(), p = dim + 1;
+        size_t groups = std::min<size_t>(64, (n + 1023) / 1024);
+        std::vector<Real> G(groups * p * p, 0.0), B(groups * p, 0.0);
+        parallel_for(groups, 1, [&](size_t begin, size_t end) {
+            std::vector<Real> xa(4 * p, 1.0);
+            for (size_t g = begin; g < end; ++g) {
+                Real* Gg = &G[g * p * p];
+                Real* Bg = &B[g * p];
+                size_t r = g * n / groups, last = (g + 1) * n / groups;
+                for (; r < last; r += 4) { // rank-4 updates of the upper triangle
+                    size_t cnt = std::min<size_t>(4, last - r);
+                    Real yr[4] = {0, 0, 0, 0};
+                    for (size_t b = 0; b < 4; ++b) {
+                        Real* row = &xa[b * p];
+                        if (b < cnt) {
+                            row[0] = 1.0;
+                            std::copy(&X[(r + b) * dim], &X[(r + b) * dim] + dim, row + 1);
+                            yr[b] = y[r + b];
+                        } else std::fill(row, row + p, 0.0);
+                    }
+                    const Real *x0 = &xa[0], *x1 = &xa[p], *x2 = &xa[2 * p], *x3 = &xa[3 * p];
+                    for (size_t j = 0; j < p; ++j) {
+                        Real a0 = x0[j], a1 = x1[j], a2 = x2[j], a3 = x3[j];
+                        Real* Gj = Gg + j * p;
+                        for (size_t k = j; k < p; ++k) Gj[k] += a0 * x0[k] + a1 * x1[k] + a2 * x2[k] + a3 * x3[k];
+                        Bg[j] += a0 * yr[0] + a1 * yr[1] + a2 * yr[2] + a3 * yr[3];
+                    }
+                }
+            }
+        });
+        for (size_t g = 0; g < groups; ++g) {
+            for (size_t j = 0; j < p; ++j) {
+                for (size_t k = j; k < p; ++k) XtX[j * p + k] += G[g * p * p + j * p + k];
+                XtY[j] += B[g * p + j];
+            }
+        }
+        for (size_t j = 0; j < p; ++j) {
+            for (size_t k = 0; k < j; ++k) XtX[j * p + k] = XtX[k * p + j];
+        }
+        rows += n;
+    }
+    // Cholesky on the (ridge-regularized) normal equations, pivoted QR when
+    // they are singular or ill-conditioned; the intercept is not penalized
+    std::vector<Real> solve(Real ridge) const {
+        size_t p = dim + 1;
+        std::vector<Real> A = XtX;
+        for (size_t j = 1; j < p; ++j) A[j * p + j] += ridge;
+        std::vector<Real> L = A;
+        if (cholesky(L, p)) return cholesky_solve(L, p, XtY);
+        return qr_solve(A, p, p, XtY);
+    }
+};
+// x as numbers (one feature) or rows of features, y as numbers
+void linreg_pack(AtomPtr node, AtomPtr x_list, AtomPtr y_list, Packed& X, Packed& y, size_t& dim) {
+    size_t rows = 0;
+    X = pack_rows(x_list, rows, dim, node);
+    y = pack_vector(y_list, node);
+    if (rows != y.size())
+        error("linear-regression: x and y must have same length", node);
+}
+AtomPtr linreg_model(const std::vector<Real>& w) {
     AtomPtr model = make_atom();
     for (size_t i = 1; i < w.size(); ++i) {
         model->tail.push_back(make_atom(w[i])); // slopes first
@@ -120,11 +850,61 @@ AtomPtr fn_linear_regression(AtomPtr node, AtomPtr env) {
     model->tail.push_back(make_atom(w[0])); // intercept last
     return model;
 }
+AtomPtr fn_linear_regression(AtomPtr node, AtomPtr env) {
+    Packed X, y;
+    size_t dim = 0;
+    linreg_pack(node, node->tail.at(0), node->tail.at(1), X, y, dim);
+    Real ridge = node->tail.size() > 2 ? type_check(node->tail.at(2), NUMBER)->value : 0;
+    if (y.empty()) error("linear-regression: no data", node);
+    LinregAcc acc(dim);
+    acc.accumulate(X, y);
+    size_t p = dim + 1, n = y.size();
+    std::vector<Real> L = acc.XtX;
+    for (size_t j = 1; j < p; ++j) L[j * p + j] += ridge;
+    if (cholesky(L, p)) return linreg_model(cholesky_solve(L, p, acc.XtY));
+    // ill-conditioned: QR on the design matrix itself, ridge as extra rows
+    size_t m = n + (ridge > 0 ? dim : 0);
+    std::vector<Real> A(m * p, 0.0), b(m, 0.0);
+    for (size_t i = 0; i < n; ++i) {
+        A[i * p] = 1.0;
+        std::copy(&X[i * dim], &X[i * dim] + dim, &A[i * p + 1]);
+        b[i] = y[i];
+    }
+    for (size_t j = 0; m > n && j < dim; ++j) A[(n + j) * p + j + 1] = std::sqrt(ridge);
+    return linreg_model(qr_solve(A, m, p, b));
+}
+AtomPtr fn_linreg_update(AtomPtr node, AtomPtr env) {
+    Packed X, y;
+    size_t dim = 0;
+    linreg_pack(node, node->tail.at(1), node->tail.at(2), X, y, dim);
+    AtomPtr acc = node->tail.at(0);
+    if (is_nil(acc)) acc = make_atom(std::make_shared<LinregAcc>(dim));
+    LinregAcc* a = object_check<LinregAcc>(acc);
+    if (y.size() && a->dim != dim) error("linreg-update: feature count mismatch", node);
+    a->accumulate(X, y);
+    return acc;
+}
+AtomPtr fn_linreg_solve(AtomPtr node, AtomPtr env) {
+    LinregAcc* a = object_check<LinregAcc>(node->tail.at(0));
+    Real ridge = node->tail.size() > 1 ? type_check(node->tail.at(1), NUMBER)->value : 0;
+    if (a->rows == 0) error("linreg-solve: no data", node);
+    return linreg_model(a->solve(ridge));
+}
 AtomPtr fn_predict_linear(AtomPtr node, AtomPtr env) {
     AtomPtr model = type_check(node->tail.at(0), LIST);
     AtomPtr x = node->tail.at(1);
     size_t n_features = model->tail.size() - 1; // last element is intercept
     Real intercept = type_check(model->tail.at(n_features), NUMBER)->value; // intercept at last position
+    if (is_matrix(x) || (x->type == LIST && x->tail.size() && x->tail.at(0)->type == LIST)) {
+        // batch: one prediction per row, as a single matrix-vector product
+        size_t rows = 0, cols = 0;
+        Packed X = pack_rows(x, rows, cols, node);
+        if (cols != n_features) error("model dimension mismatch for batch input", node);
+        Packed w = pack_vector(model, node);
+        std::vector<Real> y(rows, intercept);
+        gemm(false, false, rows, 1, cols, 1.0, X.data(), w.data(), 1.0, y.data());
+        return unpack_vector(y.data(), rows);
+    }
     Real y = intercept;
     if (x->type == NUMBER) {
         if (n_features != 1)
@@ -141,75 +921,200 @@ AtomPtr fn_predict_linear(AtomPtr node, AtomPtr env) {
     }
     return make_atom(y);
 }
-AtomPtr fn_kmeans(AtomPtr node, AtomPtr env) {
-    AtomPtr points = type_check(node->tail.at(0), LIST);
-    AtomPtr k_atom = type_check(node->tail.at(1), NUMBER);
-    int k = static_cast<int>(k_atom->value);
-    if (k <= 0) error("k must be > 0", node);
-
-    std::vector<Real> centers;
-    for (unsigned i = 0; i < (unsigned) k && i < points->tail.size(); ++i) {
-        centers.push_back(type_check(points->tail[i], NUMBER)->value);
+Real sq_dist(const Real* a, const Real* b, size_t dim) {
+    Real sum = 0;
+    for (size_t d = 0; d < dim; ++d) {
+        Real diff = a[d] - b[d];
+        sum += diff * diff;
     }
-
-    bool changed = true;
-    for (int iter = 0; iter < 10 && changed; ++iter) {
-        std::vector<std::vector<Real>> clusters(k);
-        for (auto& p : points->tail) {
-            Real val = type_check(p, NUMBER)->value;
-            int best = 0;
-            Real best_dist = std::abs(val - centers[0]);
-            for (int j = 1; j < k; ++j) {
-                Real dist = std::abs(val - centers[j]);
-                if (dist < best_dist) {
-                    best = j;
-                    best_dist = dist;
-                }
+    return sum;
+}
+// index of the nearest center and squared distances to the nearest two
+size_t nearest_center(const Real* x, const std::vector<Real>& centers, size_t k, size_t dim,
+    Real& d1, Real& d2) {
+    size_t best = 0;
+    d1 = d2 = std::numeric_limits<Real>::max();
+    for (size_t j = 0; j < k; ++j) {
+        Real d = sq_dist(x, &centers[j * dim], dim);
+        if (d < d1) {
+            d2 = d1;
+            d1 = d;
+            best = j;
+        } else if (d < d2) d2 = d;
+    }
+    return best;
+}
+// k-means++ seeding: each new center is drawn with probability proportional to D^2
+std::vector<Real> kmeans_seed(const std::vector<Real>& data, size_t n, size_t dim, size_t k, Xoshiro256& gen) {
+    std::vector<Real> centers(k * dim);
+    std::vector<Real> mind(n, std::numeric_limits<Real>::max());
+    size_t first = std::uniform_int_distribution<size_t>(0, n - 1)(gen);
+    std::copy(&data[first * dim], &data[first * dim] + dim, &centers[0]);
+    for (size_t c = 1; c < k; ++c) {
+        const Real* last = &centers[(c - 1) * dim];
+        parallel_for(n, 1024, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) mind[i] = std::min(mind[i], sq_dist(&data[i * dim], last, dim));
+        });
+        Real total = 0;
+        for (Real d : mind) total += d;
+        size_t pick = 0;
+        if (total > 0) {
+            Real r = std::uniform_real_distribution<Real>(0, total)(gen);
+            for (pick = 0; pick < n - 1; ++pick) {
+                r -= mind[pick];
+                if (r <= 0) break;
+            }
+        } else pick = std::uniform_int_distribution<size_t>(0, n - 1)(gen);
+        std::copy(&data[pick * dim], &data[pick * dim] + dim, &centers[c * dim]);
+    }
+    return centers;
+}
+// means of the assigned points, summed in fixed blocks so the result does not depend on threads
+void kmeans_update(const std::vector<Real>& data, size_t n, size_t dim, size_t k,
+    const std::vector<size_t>& assign, std::vector<Real>& centers) {
+    size_t block = std::max<size_t>(4096, n / 256 + 1);
+    size_t nblocks = (n + block - 1) / block;
+    std::vector<Real> sums(nblocks * k * dim, 0.0);
+    std::vector<size_t> counts(nblocks * k, 0);
+    parallel_for(nblocks, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            Real* s = &sums[b * k * dim];
+            size_t* c = &counts[b * k];
+            for (size_t i = b * block; i < std::min(n, (b + 1) * block); ++i) {
+                const Real* x = &data[i * dim];
+                Real* dst = s + assign[i] * dim;
+                for (size_t d = 0; d < dim; ++d) dst[d] += x[d];
+                c[assign[i]]++;
             }
-            clusters[best].push_back(val);
         }
-
-        changed = false;
-        for (int j = 0; j < k; ++j) {
-            if (clusters[j].empty()) continue;
-            Real sum = 0;
-            for (Real v : clusters[j]) sum += v;
-            Real new_center = sum / clusters[j].size();
-            if (std::abs(new_center - centers[j]) > 1e-6) {
-                centers[j] = new_center;
-                changed = true;
+    });
+    for (size_t j = 0; j < k; ++j) {
+        size_t count = 0;
+        std::vector<Real> sum(dim, 0.0);
+        for (size_t b = 0; b < nblocks; ++b) {
+            count += counts[b * k + j];
+            for (size_t d = 0; d < dim; ++d) sum[d] += sums[(b * k + j) * dim + d];
+        }
+        if (count == 0) continue; // empty cluster keeps its center
+        for (size_t d = 0; d < dim; ++d) centers[j * dim + d] = sum[d] / count;
+    }
+}
+// Lloyd iterations with Hamerly's bounds: a point is only rescanned when its
+// upper bound crosses max(lower bound, half the distance to the closest other center)
+void kmeans_hamerly(const std::vector<Real>& data, size_t n, size_t dim, size_t k, int max_iter, Real tol,
+    std::vector<Real>& centers, std::vector<size_t>& assign) {
+    std::vector<Real> upper(n), lower(n), half(k), moved(k);
+    parallel_for(n, 256, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Real d1, d2;
+            assign[i] = nearest_center(&data[i * dim], centers, k, dim, d1, d2);
+            upper[i] = std::sqrt(d1);
+            lower[i] = std::sqrt(d2);
+        }
+    });
+    for (int iter = 0; iter < max_iter; ++iter) {
+        std::vector<Real> old = centers;
+        kmeans_update(data, n, dim, k, assign, centers);
+        Real max_moved = 0;
+        for (size_t j = 0; j < k; ++j) {
+            moved[j] = std::sqrt(sq_dist(&old[j * dim], &centers[j * dim], dim));
+            max_moved = std::max(max_moved, moved[j]);
+        }
+        for (size_t j = 0; j < k; ++j) {
+            Real m = std::numeric_limits<Real>::max();
+            for (size_t jj = 0; jj < k; ++jj) {
+                if (jj != j) m = std::min(m, sq_dist(&centers[j * dim], &centers[jj * dim], dim));
+            }
+            half[j] = 0.5 * std::sqrt(m);
+        }
+        parallel_for(n, 256, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const Real* x = &data[i * dim];
+                upper[i] += moved[assign[i]];
+                lower[i] -= max_moved;
+                Real bound = std::max(half[assign[i]], lower[i]);
+                if (upper[i] <= bound) continue;
+                upper[i] = std::sqrt(sq_dist(x, &centers[assign[i] * dim], dim));
+                if (upper[i] <= bound) continue;
+                Real d1, d2;
+                assign[i] = nearest_center(x, centers, k, dim, d1, d2);
+                upper[i] = std::sqrt(d1);
+                lower[i] = std::sqrt(d2);
             }
+        });
+        if (max_moved <= tol) break; // after the pass, so assign matches the final centers
+    }
+}
+// mini-batch k-means (Sculley 2010): per-center learning rate 1 / count
+void kmeans_minibatch(const std::vector<Real>& data, size_t n, size_t dim, size_t k, int max_iter, Real tol,
+    size_t batch, Xoshiro256& gen, std::vector<Real>& centers, std::vector<size_t>& assign) {
+    std::vector<size_t> counts(k, 0), sample(batch), nearest(batch);
+    std::uniform_int_distribution<size_t> pick(0, n - 1);
+    for (int iter = 0; iter < max_iter; ++iter) {
+        for (auto& s : sample) s = pick(gen);
+        parallel_for(batch, 256, [&](size_t begin, size_t end) {
+            Real d1, d2;
+            for (size_t b = begin; b < end; ++b) nearest[b] = nearest_center(&data[sample[b] * dim], centers, k, dim, d1, d2);
+        });
+        std::vector<Real> old = centers;
+        for (size_t b = 0; b < batch; ++b) {
+            Real* c = &centers[nearest[b] * dim];
+            const Real* x = &data[sample[b] * dim];
+            Real eta = 1.0 / ++counts[nearest[b]];
+            for (size_t d = 0; d < dim; ++d) c[d] += eta * (x[d] - c[d]);
         }
+        Real max_moved = 0;
+        for (size_t j = 0; j < k; ++j) max_moved = std::max(max_moved, sq_dist(&old[j * dim], &centers[j * dim], dim));
+        if (std::sqrt(max_moved) <= tol) break;
     }
+    parallel_for(n, 256, [&](size_t begin, size_t end) {
+        Real d1, d2;
+        for (size_t i = begin; i < end; ++i) assign[i] = nearest_center(&data[i * dim], centers, k, dim, d1, d2);
+    });
+}
+AtomPtr fn_kmeans(AtomPtr node, AtomPtr env) {
+    AtomPtr points = node->tail.at(0);
+    int k = static_cast<int>(type_check(node->tail.at(1), NUMBER)->value);
+    int max_iter = 100;
+    Real tol = 1e-6;
+    size_t batch = 0;
+    if (node->tail.size() > 2) max_iter = static_cast<int>(type_check(node->tail.at(2), NUMBER)->value);
+    if (node->tail.size() > 3) tol = type_check(node->tail.at(3), NUMBER)->value;
+    if (node->tail.size() > 4) batch = static_cast<size_t>(type_check(node->tail.at(4), NUMBER)->value);
+    size_t n = 0, dim = 0;
+    Packed data = pack_rows(points, n, dim, node);
+    if (k <= 0) error("k must be > 0", node);
+    if ((size_t) k > n) error("k must not exceed the number of points", node);
+    bool is_1d = points->type == LIST && points->tail.at(0)->type == NUMBER;
 
+    Xoshiro256& gen = rng();
+    std::vector<Real> centers = kmeans_seed(data, n, dim, k, gen);
+    std::vector<size_t> assign(n, 0);
+    if (batch > 0 && batch < n) kmeans_minibatch(data, n, dim, k, max_iter, tol, batch, gen, centers, assign);
+    else kmeans_hamerly(data, n, dim, k, max_iter, tol, centers, assign);
+
+    AtomPtr c = make_atom();
+    for (int j = 0; j < k; ++j) {
+        if (is_1d) {
+            c->tail.push_back(make_atom(centers[j]));
+            continue;
+        }
+        AtomPtr row = make_atom();
+        for (size_t d = 0; d < dim; ++d) row->tail.push_back(make_atom(centers[j * dim + d]));
+        c->tail.push_back(row);
+    }
+    AtomPtr a = make_atom();
+    a->tail.reserve(n);
+    for (size_t i = 0; i < n; ++i) a->tail.push_back(make_atom((Real) assign[i]));
     AtomPtr result = make_atom();
-    for (Real c : centers) result->tail.push_back(make_atom(c));
+    result->tail.push_back(c);
+    result->tail.push_back(a);
     return result;
 }
-AtomPtr fn_knn(AtomPtr node, AtomPtr env) {
-    AtomPtr train_x = type_check(node->tail.at(0), LIST);
-    AtomPtr train_y = type_check(node->tail.at(1), LIST);
-    AtomPtr query = type_check(node->tail.at(2), LIST);
-    AtomPtr k_atom = type_check(node->tail.at(3), NUMBER);
-    int k = static_cast<int>(k_atom->value);
-    if (train_x->tail.size() != train_y->tail.size()) error("train_x and train_y must match", node);
-    std::vector<std::pair<Real, AtomPtr>> dists;
-    for (size_t i = 0; i < train_x->tail.size(); ++i) {
-        AtomPtr p = type_check(train_x->tail[i], LIST);
-        if (p->tail.size() != query->tail.size()) error("dimension mismatch", node);
-        Real dist = 0;
-        for (size_t j = 0; j < p->tail.size(); ++j) {
-            Real diff = type_check(p->tail[j], NUMBER)->value - type_check(query->tail[j], NUMBER)->value;
-            dist += diff * diff;
-        }
-        dists.push_back({std::sqrt(dist), train_y->tail[i]});
-    }
-    std::sort(dists.begin(), dists.end(), [](auto& a, auto& b) { return a.first < b.first; });
+// majority vote among neighbour labels, ties go to the smallest label
+Real knn_vote(const std::vector<Real>& labels) {
     std::map<Real, int> votes;
-    for (unsigned i = 0; i < (unsigned) k && i < dists.size(); ++i) {
-        Real label = type_check(dists[i].second, NUMBER)->value;
-        votes[label]++;
-    }
+    for (Real l : labels) votes[l]++;
     Real best_label = 0;
     int best_count = -1;
     for (auto& kv : votes) {
@@ -218,207 +1123,514 @@ AtomPtr fn_knn(AtomPtr node, AtomPtr env) {
             best_count = kv.second;
         }
     }
-    return make_atom(best_label);
+    return best_label;
 }
-AtomPtr random_matrix(int rows, int cols) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<Real> dis(-1.0, 1.0);
-    AtomPtr mat = make_atom();
-    for (int i = 0; i < rows; ++i) {
-        AtomPtr row = make_atom();
-        for (int j = 0; j < cols; ++j) {
-            row->tail.push_back(make_atom(dis(gen)));
-        }
-        mat->tail.push_back(row);
+// brute force; a matrix or list of query rows gives one label per row
+AtomPtr fn_knn(AtomPtr node, AtomPtr env) {
+    size_t n = 0, dim = 0, nq = 0, qdim = 0;
+    Packed X = pack_rows(node->tail.at(0), n, dim, node);
+    Packed labels = pack_vector(node->tail.at(1), node);
+    AtomPtr query = node->tail.at(2);
+    AtomPtr k_atom = type_check(node->tail.at(3), NUMBER);
+    int k = static_cast<int>(k_atom->value);
+    if (n != labels.size()) error("train_x and train_y must match", node);
+    bool batch = is_matrix(query) || (type_check(query, LIST)->tail.size() && query->tail.at(0)->type == LIST);
+    Packed Q = batch ? pack_rows(query, nq, qdim, node) : pack_vector(query, node);
+    if (!batch) {
+        nq = 1;
+        qdim = Q.size();
     }
-    return mat;
+    if (qdim != dim) error("dimension mismatch", node);
+    size_t kk = std::min<size_t>(std::max(k, 0), n);
+    std::vector<Real> predicted(nq);
+    const size_t QB = 64; // queries per distance block
+    parallel_for((nq + QB - 1) / QB, 1, [&](size_t b, size_t e) {
+        std::vector<Real> D(QB * n);
+        std::vector<std::pair<Real, Real>> dists(n);
+        std::vector<Real> neigh;
+        for (size_t q0 = b * QB; q0 < std::min(nq, e * QB); q0 += QB) {
+            size_t rows = std::min(QB, nq - q0);
+            distance_matrix(&Q[q0 * dim], rows, X.data(), n, dim, SQEUCLIDEAN, D.data());
+            for (size_t r = 0; r < rows; ++r) {
+                for (size_t i = 0; i < n; ++i) dists[i] = {D[r * n + i], labels[i]};
+                std::partial_sort(dists.begin(), dists.begin() + kk, dists.end(), [](auto& a, auto& b) { return a.first < b.first; });
+                neigh.clear();
+                for (size_t i = 0; i < kk; ++i) neigh.push_back(dists[i].second);
+                predicted[q0 + r] = knn_vote(neigh);
+            }
+        }
+    });
+    if (!batch) return make_atom(predicted[0]);
+    return unpack_vector(predicted.data(), nq);
 }
-AtomPtr zero_vector(int size) {
-    AtomPtr vec = make_atom();
-    for (int i = 0; i < size; ++i) {
-        vec->tail.push_back(make_atom(0.0));
+struct KnnIndex : public Object {
+    static constexpr const char* NAME = "knn-index";
+    const char* name() const { return NAME; }
+    void print(std::ostream& out) const {
+        out << "<knn-index " << perm.size() << "x" << dim << ">";
     }
-    return vec;
-}
-AtomPtr fn_nn_init(AtomPtr node, AtomPtr env) {
-    AtomPtr sizes = type_check(node->tail.at(0), LIST);
-    AtomPtr activations = type_check(node->tail.at(1), LIST);
-    if (sizes->tail.size() != activations->tail.size() + 1) {
-        error("nn-init: activations must be one less than sizes", node);
+    struct Node {
+        size_t begin, end;
+        size_t split_dim;
+        Real split;
+        int left, right; // -1 for leaves
+    };
+    static const size_t LEAF_SIZE = 16;
+    size_t dim;
+    std::vector<Real> points; // packed in tree order
+    std::vector<size_t> perm; // tree order -> original row
+    std::vector<Real> labels; // in tree order
+    std::vector<Node> nodes;
+
+    KnnIndex(const std::vector<Real>& data, const std::vector<Real>& y, size_t d) : dim(d) {
+        size_t n = y.size();
+        perm.resize(n);
+        for (size_t i = 0; i < n; ++i) perm[i] = i;
+        if (n) build(data, 0, n);
+        points.resize(n * dim);
+        labels.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            std::copy(&data[perm[i] * dim], &data[perm[i] * dim] + dim, &points[i * dim]);
+            labels[i] = y[perm[i]];
+        }
     }
-    AtomPtr net = make_atom();
-    for (size_t i = 0; i < activations->tail.size(); ++i) {
-        int in_size = type_check(sizes->tail.at(i), NUMBER)->value;
-        int out_size = type_check(sizes->tail.at(i + 1), NUMBER)->value;
-        AtomPtr layer = make_atom();
-        layer->tail.push_back(random_matrix(out_size, in_size)); // weights
-        layer->tail.push_back(zero_vector(out_size));            // biases
-        layer->tail.push_back(type_check(activations->tail.at(i), STRING)); // activation
-        net->tail.push_back(layer);
+    int build(const std::vector<Real>& data, size_t begin, size_t end) {
+        int id = nodes.size();
+        nodes.push_back({begin, end, 0, 0, -1, -1});
+        if (end - begin <= LEAF_SIZE) return id;
+        // split on the dimension with the largest spread
+        size_t best = 0;
+        Real spread = -1;
+        for (size_t d = 0; d < dim; ++d) {
+            Real lo = data[perm[begin] * dim + d], hi = lo;
+            for (size_t i = begin + 1; i < end; ++i) {
+                Real v = data[perm[i] * dim + d];
+                lo = std::min(lo, v);
+                hi = std::max(hi, v);
+            }
+            if (hi - lo > spread) {
+                spread = hi - lo;
+                best = d;
+            }
+        }
+        size_t mid = begin + (end - begin) / 2;
+        std::nth_element(perm.begin() + begin, perm.begin() + mid, perm.begin() + end,
+            [&](size_t a, size_t b) { return data[a * dim + best] < data[b * dim + best]; });
+        nodes[id].split_dim = best;
+        nodes[id].split = data[perm[mid] * dim + best];
+        int l = build(data, begin, mid);
+        int r = build(data, mid, end);
+        nodes[id].left = l;
+        nodes[id].right = r;
+        return id;
+    }
+    typedef std::priority_queue<std::pair<Real, size_t>> Heap; // max-heap on squared distance
+    void search(int id, const Real* q, size_t k, Heap& heap) const {
+        const Node& nd = nodes[id];
+        if (nd.left < 0) {
+            for (size_t i = nd.begin; i < nd.end; ++i) {
+                const Real* p = &points[i * dim];
+                Real dist = 0;
+                for (size_t d = 0; d < dim; ++d) {
+                    Real diff = p[d] - q[d];
+                    dist += diff * diff;
+                }
+                if (heap.size() < k) heap.push({dist, i});
+                else if (dist < heap.top().first) {
+                    heap.pop();
+                    heap.push({dist, i});
+                }
+            }
+            return;
+        }
+        Real diff = q[nd.split_dim] - nd.split;
+        int near = diff < 0 ? nd.left : nd.right;
+        int far = diff < 0 ? nd.right : nd.left;
+        search(near, q, k, heap);
+        if (heap.size() < k || diff * diff < heap.top().first) search(far, q, k, heap);
     }
-    return net;
+    // nearest k rows sorted by distance: (tree position, distance)
+    std::vector<std::pair<size_t, Real>> query(const Real* q, size_t k) const {
+        Heap heap;
+        if (!nodes.empty() && k > 0) search(0, q, k, heap);
+        std::vector<std::pair<size_t, Real>> out(heap.size());
+        for (size_t i = out.size(); i-- > 0; heap.pop()) {
+            out[i] = {heap.top().second, std::sqrt(heap.top().first)};
+        }
+        return out;
+    }
+};
+AtomPtr fn_knn_index(AtomPtr node, AtomPtr env) {
+    size_t rows = 0, dim = 0;
+    Packed data = pack_rows(node->tail.at(0), rows, dim, node);
+    if (dim == 0) error("train_x needs at least one feature", node);
+    Packed labels = pack_vector(node->tail.at(1), node);
+    if (labels.size() != rows) error("train_x and train_y must match", node);
+    return make_atom(std::make_shared<KnnIndex>(data, labels, dim));
 }
+AtomPtr fn_knn_query(AtomPtr node, AtomPtr env) {
+    KnnIndex* index = object_check<KnnIndex>(node->tail.at(0));
+    AtomPtr query = node->tail.at(1);
+    int k = static_cast<int>(type_check(node->tail.at(2), NUMBER)->value);
+    if (k <= 0) error("k must be > 0", node);
+    bool full = false;
+    if (node->tail.size() > 3) {
+        std::string mode = type_check(node->tail.at(3), SYMBOL)->lexeme;
+        if (mode == "full") full = true;
+        else if (mode != "label") error("knn-query: mode must be label or full", node);
+    }
+    bool batch = is_matrix(query) || (type_check(query, LIST)->tail.size() > 0 && query->tail.at(0)->type == LIST);
+    size_t nq = 1, dim = 0;
+    Packed q = batch ? pack_rows(query, nq, dim, node) : pack_vector(query, node);
+    if (!batch) dim = q.size();
+    if (dim != index->dim) error("dimension mismatch", node);
 
+    std::vector<std::vector<std::pair<size_t, Real>>> found(nq);
+    std::vector<Real> predicted(nq);
+    parallel_for(nq, 8, [&](size_t begin, size_t end) {
+        std::vector<Real> neigh;
+        for (size_t i = begin; i < end; ++i) {
+            found[i] = index->query(&q[i * dim], k);
+            neigh.clear();
+            for (auto& f : found[i]) neigh.push_back(index->labels[f.first]);
+            predicted[i] = knn_vote(neigh);
+        }
+    });
+
+    AtomPtr result = make_atom();
+    for (size_t i = 0; i < nq; ++i) {
+        AtomPtr r = make_atom(predicted[i]);
+        if (full) {
+            AtomPtr indices = make_atom(), distances = make_atom();
+            for (auto& f : found[i]) {
+                indices->tail.push_back(make_atom((Real) index->perm[f.first]));
+                distances->tail.push_back(make_atom(f.second));
+            }
+            r = make_atom();
+            r->tail.push_back(make_atom(predicted[i]));
+            r->tail.push_back(indices);
+            r->tail.push_back(distances);
+        }
+        if (!batch) return r;
+        result->tail.push_back(r);
+    }
+    return result;
+}
 Real relu(Real x) { return x > 0 ? x : 0; }
 Real relu_deriv(Real x) { return x > 0 ? 1 : 0; }
 Real sigmoid(Real x) { return 1.0 / (1.0 + std::exp(-x)); }
 Real sigmoid_deriv(Real x) { Real s = sigmoid(x); return s * (1 - s); }
-std::vector<Real> matvec_mul(AtomPtr mat, const std::vector<Real>& vec) {
-    std::vector<Real> result;
-    for (auto& row : mat->tail) {
-        Real sum = 0.0;
-        for (size_t j = 0; j < row->tail.size(); ++j) {
-            sum += type_check(row->tail.at(j), NUMBER)->value * vec.at(j);
-        }
-        result.push_back(sum);
+void softmax(Real* v, size_t n) {
+    Real maxval = *std::max_element(v, v + n); // for numerical stability
+    Real sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        v[i] = std::exp(v[i] - maxval);
+        sum += v[i];
     }
-    return result;
-}
-void add_bias(std::vector<Real>& v, AtomPtr bias) {
-    for (size_t i = 0; i < v.size(); ++i) {
-        v[i] += type_check(bias->tail.at(i), NUMBER)->value;
+    for (size_t i = 0; i < n; ++i) {
+        v[i] /= sum;
     }
 }
-void softmax(std::vector<Real>& v) {
-    Real maxval = *std::max_element(v.begin(), v.end()); // for numerical stability
-    Real sum = 0;
-    for (auto& e : v) {
-        e = std::exp(e - maxval);
-        sum += e;
+enum Activation {RELU, SIGMOID, SOFTMAX};
+const char* ACTIVATION_NAMES[] = {"relu", "sigmoid", "softmax"};
+struct NeuralNet : public Object {
+    static constexpr const char* NAME = "nn";
+    const char* name() const { return NAME; }
+    void print(std::ostream& out) const {
+        out << "<nn";
+        for (size_t l = 0; l < layers.size(); ++l) {
+            if (l == 0) out << " " << layers[l].in;
+            out << "-" << layers[l].out;
+        }
+        for (auto& l : layers) out << " " << ACTIVATION_NAMES[l.act];
+        out << ">";
+    }
+    struct Layer {
+        size_t in, out;
+        Activation act;
+        std::vector<Real> W; // out x in, row-major
+        std::vector<Real> b; // out
+    };
+    std::vector<Layer> layers;
+    size_t inputs() const { return layers.front().in; }
+    size_t outputs() const { return layers.back().out; }
+
+    static void activate(std::vector<Real>& z, size_t rows, size_t cols, Activation act) {
+        switch (act) {
+        case RELU:
+            for (auto& v : z) v = relu(v);
+        break;
+        case SIGMOID:
+            for (auto& v : z) v = sigmoid(v);
+        break;
+        case SOFTMAX:
+            for (size_t r = 0; r < rows; ++r) softmax(&z[r * cols], cols);
+        break;
+        }
+    }
+    // forward pass over a batch of rows; keeps per-layer activations
+    // (acts[0] is the input) and pre-activations for backpropagation
+    void forward(const Real* x, size_t batch, std::vector<std::vector<Real>>& acts,
+        std::vector<std::vector<Real>>& pre) const {
+        acts.resize(layers.size() + 1);
+        pre.resize(layers.size());
+        acts[0].assign(x, x + batch * inputs());
+        for (size_t l = 0; l < layers.size(); ++l) {
+            const Layer& L = layers[l];
+            std::vector<Real>& z = pre[l];
+            z.resize(batch * L.out);
+            for (size_t r = 0; r < batch; ++r) std::copy(L.b.begin(), L.b.end(), &z[r * L.out]);
+            gemm(false, true, batch, L.out, L.in, 1.0, acts[l].data(), L.W.data(), 1.0, z.data());
+            acts[l + 1] = z;
+            activate(acts[l + 1], batch, L.out, L.act);
+        }
     }
-    for (auto& e : v) {
-        e /= sum;
+    struct Grad {
+        std::vector<std::vector<Real>> W, b;
+    };
+    void zero_grad(Grad& g) const {
+        g.W.resize(layers.size());
+        g.b.resize(layers.size());
+        for (size_t l = 0; l < layers.size(); ++l) {
+            g.W[l].assign(layers[l].W.size(), 0.0);
+            g.b[l].assign(layers[l].b.size(), 0.0);
+        }
     }
+    // adds the gradients of the summed cross-entropy over a batch to g; returns the summed loss
+    Real backprop(const Real* x, const Real* y, size_t batch, Grad& g) const {
+        std::vector<std::vector<Real>> acts, pre;
+        forward(x, batch, acts, pre);
+        const std::vector<Real>& out = acts.back();
+        Real loss = 0;
+        for (size_t i = 0; i < out.size(); ++i) loss -= y[i] * std::log(std::max(out[i], 1e-12));
+        std::vector<Real> delta(out.size()), prev;
+        for (size_t i = 0; i < out.size(); ++i) delta[i] = out[i] - y[i]; // softmax + cross-entropy
+        for (size_t l = layers.size(); l-- > 0;) {
+            const Layer& L = layers[l];
+            if (L.act == RELU) for (size_t i = 0; i < delta.size(); ++i) delta[i] *= relu_deriv(pre[l][i]);
+            else if (L.act == SIGMOID) for (size_t i = 0; i < delta.size(); ++i) delta[i] *= sigmoid_deriv(pre[l][i]);
+            gemm(true, false, L.out, L.in, batch, 1.0, delta.data(), acts[l].data(), 1.0, g.W[l].data());
+            for (size_t r = 0; r < batch; ++r) {
+                for (size_t o = 0; o < L.out; ++o) g.b[l][o] += delta[r * L.out + o];
+            }
+            if (l > 0) {
+                prev.resize(batch * L.in);
+                gemm(false, false, batch, L.in, L.out, 1.0, delta.data(), L.W.data(), 0.0, prev.data());
+                delta.swap(prev);
+            }
+        }
+        return loss;
+    }
+    // data-parallel gradient: fixed shards of rows are backpropagated on
+    // separate threads and summed in shard order, so results are reproducible
+    Real gradient(const Real* x, const Real* y, size_t batch, Grad& g) const {
+        const size_t SHARD = 32;
+        size_t shards = (batch + SHARD - 1) / SHARD;
+        zero_grad(g);
+        if (shards <= 1) return backprop(x, y, batch, g);
+        std::vector<Grad> partial(shards);
+        std::vector<Real> losses(shards);
+        parallel_for(shards, 1, [&](size_t begin, size_t end) {
+            for (size_t s = begin; s < end; ++s) {
+                size_t r0 = s * SHARD, rows = std::min(SHARD, batch - r0);
+                zero_grad(partial[s]);
+                losses[s] = backprop(x + r0 * inputs(), y + r0 * outputs(), rows, partial[s]);
+            }
+        });
+        Real loss = 0;
+        for (size_t s = 0; s < shards; ++s) {
+            loss += losses[s];
+            for (size_t l = 0; l < layers.size(); ++l) {
+                for (size_t i = 0; i < g.W[l].size(); ++i) g.W[l][i] += partial[s].W[l][i];
+                for (size_t i = 0; i < g.b[l].size(); ++i) g.b[l][i] += partial[s].b[l][i];
+            }
+        }
+        return loss;
+    }
+    // optimizer state persists in the network across calls
+    enum Optimizer {SGD, MOMENTUM, ADAM};
+    struct State {
+        std::vector<Real> m, v;
+    };
+    std::vector<State> state; // two per layer: weights, biases
+    size_t steps = 0;
+    static void update(std::vector<Real>& w, const std::vector<Real>& grad, Real scale, Real lr,
+        Optimizer opt, State& st, size_t t) {
+        const Real mu = 0.9, beta1 = 0.9, beta2 = 0.999, eps = 1e-8;
+        if (opt == SGD) {
+            for (size_t i = 0; i < w.size(); ++i) w[i] -= lr * scale * grad[i];
+            return;
+        }
+        if (st.m.size() != w.size()) st.m.assign(w.size(), 0.0), st.v.assign(w.size(), 0.0);
+        if (opt == MOMENTUM) {
+            for (size_t i = 0; i < w.size(); ++i) {
+                st.m[i] = mu * st.m[i] - lr * scale * grad[i];
+                w[i] += st.m[i];
+            }
+            return;
+        }
+        Real c1 = 1 - std::pow(beta1, t), c2 = 1 - std::pow(beta2, t);
+        for (size_t i = 0; i < w.size(); ++i) {
+            Real gi = scale * grad[i];
+            st.m[i] = beta1 * st.m[i] + (1 - beta1) * gi;
+            st.v[i] = beta2 * st.v[i] + (1 - beta2) * gi * gi;
+            w[i] -= lr * (st.m[i] / c1) / (std::sqrt(st.v[i] / c2) + eps);
+        }
+    }
+    // one optimizer step on a batch; returns the mean cross-entropy loss
+    Real train(const Real* x, const Real* y, size_t batch, Real lr, Optimizer opt = SGD) {
+        Grad g;
+        Real loss = gradient(x, y, batch, g);
+        state.resize(2 * layers.size());
+        ++steps;
+        for (size_t l = 0; l < layers.size(); ++l) {
+            update(layers[l].W, g.W[l], 1.0 / batch, lr, opt, state[2 * l], steps);
+            update(layers[l].b, g.b[l], 1.0 / batch, lr, opt, state[2 * l + 1], steps);
+        }
+        return loss / batch;
+    }
+};
+// single sample (list of numbers) or batch (list of rows), packed row-major
+Packed pack_samples(AtomPtr list, size_t width, size_t& batch, bool& is_batch, AtomPtr node) {
+    is_batch = is_matrix(list) || (type_check(list, LIST)->tail.size() > 0 && list->tail.at(0)->type == LIST);
+    size_t cols = 0;
+    batch = 1;
+    Packed data = is_batch ? pack_rows(list, batch, cols, node) : pack_vector(list, node);
+    if (!is_batch) cols = data.size();
+    if (cols != width) error("input size does not match the network", node);
+    return data;
 }
-AtomPtr fn_nn_predict(AtomPtr node, AtomPtr env) {
-    AtomPtr net = type_check(node->tail.at(0), LIST);
-    AtomPtr input = type_check(node->tail.at(1), LIST);
-    std::vector<Real> vec;
-    for (auto& e : input->tail) vec.push_back(type_check(e, NUMBER)->value);
-    for (size_t l = 0; l < net->tail.size(); ++l) {
-        AtomPtr layer = net->tail.at(l);
-        AtomPtr weights = layer->tail.at(0);
-        AtomPtr biases = layer->tail.at(1);
-        std::string act = type_check(layer->tail.at(2), STRING)->lexeme;
-        vec = matvec_mul(weights, vec);
-        add_bias(vec, biases);
-        if (act == "relu") for (auto& x : vec) x = relu(x);
-        else if (act == "sigmoid") for (auto& x : vec) x = sigmoid(x);
-        else if (act == "softmax") softmax(vec);
-        else error("unknown activation", layer);
+AtomPtr fn_nn_init(AtomPtr node, AtomPtr env) {
+    AtomPtr sizes = type_check(node->tail.at(0), LIST);
+    AtomPtr activations = type_check(node->tail.at(1), LIST);
+    if (sizes->tail.size() != activations->tail.size() + 1) {
+        error("nn-init: activations must be one less than sizes", node);
     }
-    AtomPtr out = make_atom();
-    for (auto v : vec) out->tail.push_back(make_atom(v));
-    return out;
+    auto net = std::make_shared<NeuralNet>();
+    for (size_t i = 0; i < activations->tail.size(); ++i) {
+        NeuralNet::Layer layer;
+        layer.in = type_check(sizes->tail.at(i), NUMBER)->value;
+        layer.out = type_check(sizes->tail.at(i + 1), NUMBER)->value;
+        std::string act = type_check(activations->tail.at(i), STRING)->lexeme;
+        if (act == "relu") layer.act = RELU;
+        else if (act == "sigmoid") layer.act = SIGMOID;
+        else if (act == "softmax") layer.act = SOFTMAX;
+        else error("unknown activation", activations->tail.at(i));
+        layer.W.resize(layer.out * layer.in);
+        random_fill(layer.W.data(), layer.W.size(), UNIFORM, -1.0, 1.0);
+        layer.b.assign(layer.out, 0.0);
+        net->layers.push_back(layer);
+    }
+    return make_atom(net);
 }
 
-void apply_activation_deriv(std::vector<Real>& vec, const std::vector<Real>& pre_act, const std::string& act) {
-    for (size_t i = 0; i < vec.size(); ++i) {
-        if (act == "relu") {
-            vec[i] *= relu_deriv(pre_act[i]);
-        } else if (act == "sigmoid") {
-            vec[i] *= sigmoid_deriv(pre_act[i]);
-        }
+AtomPtr fn_nn_predict(AtomPtr node, AtomPtr env) {
+    NeuralNet* net = object_check<NeuralNet>(node->tail.at(0));
+    size_t batch = 0;
+    bool is_batch = false;
+    Packed x = pack_samples(node->tail.at(1), net->inputs(), batch, is_batch, node);
+    std::vector<std::vector<Real>> acts, pre;
+    net->forward(x.data(), batch, acts, pre);
+    std::vector<Real>& y = acts.back();
+    size_t width = net->outputs();
+    if (is_matrix(node->tail.at(1))) return make_matrix(batch, width, std::move(y));
+    AtomPtr out = make_atom();
+    for (size_t r = 0; r < batch; ++r) {
+        AtomPtr row = is_batch ? make_atom() : out;
+        for (size_t o = 0; o < width; ++o) row->tail.push_back(make_atom(y[r * width + o]));
+        if (is_batch) out->tail.push_back(row);
     }
+    return out;
 }
 AtomPtr fn_nn_train(AtomPtr node, AtomPtr env) {
-    AtomPtr net = type_check(node->tail.at(0), LIST);
-    AtomPtr input = type_check(node->tail.at(1), LIST);
-    AtomPtr target = type_check(node->tail.at(2), LIST);
+    NeuralNet* net = object_check<NeuralNet>(node->tail.at(0));
     Real lr = type_check(node->tail.at(3), NUMBER)->value;
-
-    std::vector<Real> x;
-    for (auto& e : input->tail) x.push_back(type_check(e, NUMBER)->value);
-    std::vector<Real> y;
-    for (auto& e : target->tail) y.push_back(type_check(e, NUMBER)->value);
-
-    std::vector<std::vector<Real>> activations = {x};
-    std::vector<std::vector<Real>> pre_activations;
-
-    for (size_t l = 0; l < net->tail.size(); ++l) {
-        AtomPtr layer = net->tail.at(l);
-        AtomPtr weights = layer->tail.at(0);
-        AtomPtr biases = layer->tail.at(1);
-        std::string act = type_check(layer->tail.at(2), STRING)->lexeme;
-        std::vector<Real> z = matvec_mul(weights, activations.back());
-        add_bias(z, biases);
-        pre_activations.push_back(z);
-        std::vector<Real> a = z;
-        if (act == "relu") for (auto& v : a) v = relu(v);
-        else if (act == "sigmoid") for (auto& v : a) v = sigmoid(v);
-        else if (act == "softmax") softmax(a);
-        else error("unknown activation", layer);
-        activations.push_back(a);
-    }
-
-    Real loss = 0;
-    for (size_t i = 0; i < activations.back().size(); ++i) {
-        loss -= y[i] * std::log(std::max(activations.back()[i], 1e-12));
+    size_t batch = 0, targets = 0;
+    bool is_batch = false, targets_batch = false;
+    Packed x = pack_samples(node->tail.at(1), net->inputs(), batch, is_batch, node);
+    Packed y = pack_samples(node->tail.at(2), net->outputs(), targets, targets_batch, node);
+    if (batch != targets) error("nn-train: inputs and targets must match", node);
+    return make_atom(net->train(x.data(), y.data(), batch, lr));
+}
+AtomPtr fn_nn_fit(AtomPtr node, AtomPtr env) {
+    NeuralNet* net = object_check<NeuralNet>(node->tail.at(0));
+    size_t n = 0, targets = 0, cols = 0, tcols = 0;
+    Packed x = pack_rows(node->tail.at(1), n, cols, node);
+    Packed y = pack_rows(node->tail.at(2), targets, tcols, node);
+    if (cols != net->inputs() || tcols != net->outputs()) error("nn-fit: data size does not match the network", node);
+    if (n != targets) error("nn-fit: inputs and targets must match", node);
+    int epochs = static_cast<int>(type_check(node->tail.at(3), NUMBER)->value);
+    Real lr = type_check(node->tail.at(4), NUMBER)->value;
+    size_t batch = 32;
+    if (node->tail.size() > 5) {
+        Real b = type_check(node->tail.at(5), NUMBER)->value;
+        batch = b < n ? std::max<Real>(1, b) : n; // clamped in Real, so huge values cannot overflow
     }
-
-    std::vector<Real> delta = activations.back();
-    for (size_t i = 0; i < delta.size(); ++i) {
-        delta[i] -= y[i]; // derivative of softmax + cross-entropy
+    batch = std::max<size_t>(1, std::min(batch, n)); // buffers below hold one batch
+    NeuralNet::Optimizer opt = NeuralNet::SGD;
+    if (node->tail.size() > 6) {
+        std::string name = type_check(node->tail.at(6), SYMBOL)->lexeme;
+        if (name == "momentum") opt = NeuralNet::MOMENTUM;
+        else if (name == "adam") opt = NeuralNet::ADAM;
+        else if (name != "sgd") error("nn-fit: optimizer must be sgd, momentum or adam", node);
     }
+    bool verbose = node->tail.size() > 7 && type_check(node->tail.at(7), NUMBER)->value;
 
-    for (int l = net->tail.size() - 1; l >= 0; --l) {
-        AtomPtr layer = net->tail.at(l);
-        AtomPtr weights = layer->tail.at(0);
-        AtomPtr biases = layer->tail.at(1);
-        std::string act = type_check(layer->tail.at(2), STRING)->lexeme;
-
-        if (act != "softmax") {
-            apply_activation_deriv(delta, pre_activations[l], act);
-        }
-
-        for (size_t i = 0; i < weights->tail.size(); ++i) {
-            for (size_t j = 0; j < weights->tail.at(i)->tail.size(); ++j) {
-                Real w = type_check(weights->tail.at(i)->tail.at(j), NUMBER)->value;
-                Real grad = delta[i] * activations[l][j];
-                weights->tail.at(i)->tail.at(j) = make_atom(w - lr * grad);
+    Xoshiro256& gen = rng();
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; ++i) order[i] = i;
+    std::vector<Real> bx(batch * cols), by(batch * tcols);
+    AtomPtr losses = make_atom();
+    for (int e = 0; e < epochs; ++e) {
+        std::shuffle(order.begin(), order.end(), gen);
+        Real total = 0;
+        for (size_t b0 = 0; b0 < n; b0 += batch) {
+            size_t rows = std::min(batch, n - b0);
+            for (size_t r = 0; r < rows; ++r) {
+                std::copy(&x[order[b0 + r] * cols], &x[order[b0 + r] * cols] + cols, &bx[r * cols]);
+                std::copy(&y[order[b0 + r] * tcols], &y[order[b0 + r] * tcols] + tcols, &by[r * tcols]);
             }
+            total += net->train(bx.data(), by.data(), rows, lr, opt) * rows;
         }
-        for (size_t i = 0; i < biases->tail.size(); ++i) {
-            Real b = type_check(biases->tail.at(i), NUMBER)->value;
-            biases->tail.at(i) = make_atom(b - lr * delta[i]);
-        }
-
-        if (l > 0) {
-            std::vector<Real> new_delta(activations[l].size(), 0.0);
-            for (size_t j = 0; j < activations[l].size(); ++j) {
-                for (size_t i = 0; i < weights->tail.size(); ++i) {
-                    new_delta[j] += type_check(weights->tail.at(i)->tail.at(j), NUMBER)->value * delta[i];
-                }
+        Real loss = n ? total / n : 0;
+        if (verbose) *output << "epoch " << e << " | loss: " << loss << std::endl;
+        losses->tail.push_back(make_atom(loss));
+    }
+    return losses;
+}
+using Complex = std::complex<Real>;
+// iterative radix-2 transform in place (n must be a power of two);
+// allocation free, so it can run inside real-time processing loops
+void fft_compute(Complex* a, size_t n, bool invert) {
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(a[i], a[j]);
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        Real ang = 2 * M_PI / len * (invert ? -1 : 1);
+        size_t half = len / 2;
+        Complex w(1), wn = std::polar((Real) 1, ang);
+        for (size_t j = 0; j < half; ++j) {
+            // the twiddle recurrence is re-anchored to bound rounding drift
+            if (j % 32 == 0) w = std::polar((Real) 1, ang * j);
+            Real wr = w.real(), wi = w.imag();
+            for (size_t i = j; i < n; i += len) {
+                Real xr = a[i + half].real(), xi = a[i + half].imag();
+                Complex v(xr * wr - xi * wi, xr * wi + xi * wr);
+                a[i + half] = a[i] - v;
+                a[i] += v;
             }
-            delta = new_delta;
+            w = Complex(wr * wn.real() - wi * wn.imag(), wr * wn.imag() + wi * wn.real());
         }
     }
-
-    return make_atom(loss);
+    if (invert) {
+        for (size_t i = 0; i < n; ++i) a[i] /= (Real) n;
+    }
 }
-using Complex = std::complex<Real>;
 void fft_compute(std::vector<Complex>& a, bool invert) {
-    size_t n = a.size();
-    if (n == 1) return;
-    std::vector<Complex> a0(n / 2), a1(n / 2);
-    for (size_t i = 0; 2 * i < n; ++i) {
-        a0[i] = a[i*2];
-        a1[i] = a[i*2+1];
-    }
-    fft_compute(a0, invert);
-    fft_compute(a1, invert);
-    Real ang = 2 * M_PI / n * (invert ? -1 : 1);
-    Complex w(1), wn(cos(ang), sin(ang));
-    for (size_t i = 0; 2 * i < n; ++i) {
-        a[i] = a0[i] + w * a1[i];
-        a[i + n/2] = a0[i] - w * a1[i];
-        if (invert) {
-            a[i] /= 2;
-            a[i + n/2] /= 2;
-        }
-        w *= wn;
-    }
+    fft_compute(a.data(), a.size(), invert);
 }
 bool is_power_of_two(size_t n) {
     return (n > 0) && ((n & (n-1)) == 0);
@@ -510,46 +1722,284 @@ AtomPtr fn_conv(AtomPtr node, AtomPtr env) {
     return out;
 }
 AtomPtr fn_dot(AtomPtr node, AtomPtr env) {
-    AtomPtr a = type_check(node->tail.at(0), LIST);
-    AtomPtr b = type_check(node->tail.at(1), LIST);
-    const auto& atail = a->tail;
-    const auto& btail = b->tail;
-    size_t n = atail.size();
-    if (n != btail.size()) {
+    Packed a = pack_vector(node->tail.at(0), node);
+    Packed b = pack_vector(node->tail.at(1), node);
+    if (a.size() != b.size()) {
         error("mismatched vector lengths", node);
     }
-    Real sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
-    size_t i = 0;
-    // process blocks of 4
-    for (; i + 3 < n; i += 4) {
-        sum0 += type_check(atail[i+0], NUMBER)->value * type_check(btail[i+0], NUMBER)->value;
-        sum1 += type_check(atail[i+1], NUMBER)->value * type_check(btail[i+1], NUMBER)->value;
-        sum2 += type_check(atail[i+2], NUMBER)->value * type_check(btail[i+2], NUMBER)->value;
-        sum3 += type_check(atail[i+3], NUMBER)->value * type_check(btail[i+3], NUMBER)->value;
+    return make_atom(dot_product(a.data(), b.data(), a.size()));
+}
+// one channel (list of numbers or matrix) or several (list of lists, as
+// returned by readwav); multi tells which shape to give back
+std::vector<std::vector<Real>> pack_channels(AtomPtr signal, bool& multi, AtomPtr node) {
+    multi = signal->type == LIST && signal->tail.size() && signal->tail.at(0)->type == LIST;
+    std::vector<std::vector<Real>> chans;
+    if (!multi) chans.push_back(pack_vector(signal, node).take());
+    else for (auto& c : signal->tail) chans.push_back(pack_vector(c, node).take());
+    return chans;
+}
+AtomPtr unpack_channels(const std::vector<std::vector<Real>>& chans, bool multi) {
+    if (!multi) return unpack_vector(chans[0].data(), chans[0].size());
+    AtomPtr result = make_atom();
+    for (auto& c : chans) result->tail.push_back(unpack_vector(c.data(), c.size()));
+    return result;
+}
+// direct-form FIR with zero initial state; output has the input length
+AtomPtr fn_fir(AtomPtr node, AtomPtr env) {
+    bool multi;
+    std::vector<std::vector<Real>> chans = pack_channels(node->tail.at(0), multi, node);
+    std::vector<Real> h = pack_vector(node->tail.at(1), node).take(); // reversed in place
+    if (h.empty()) error("empty filter", node);
+    std::reverse(h.begin(), h.end());
+    size_t taps = h.size();
+    for (auto& x : chans) {
+        std::vector<Real> xp(taps - 1 + x.size(), 0);
+        std::copy(x.begin(), x.end(), xp.begin() + taps - 1);
+        parallel_for(x.size(), 1 << 12, [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; ++i) x[i] = dot_product(h.data(), &xp[i], taps);
+        });
     }
-    for (; i < n; ++i) {
-        sum0 += type_check(atail[i], NUMBER)->value * type_check(btail[i], NUMBER)->value;
+    return unpack_channels(chans, multi);
+}
+// cascaded second-order sections (b0 b1 b2 a1 a2, or with a0 in fourth
+// position) in transposed direct form II; the delay lines survive between
+// calls so long signals can be filtered block by block
+struct FilterState : public Object {
+    static constexpr const char* NAME = "filter-state";
+    const char* name() const { return NAME; }
+    void print(std::ostream& out) const {
+        out << "<filter-state " << sections.size() << " sections>";
     }
-
-    return make_atom(sum0 + sum1 + sum2 + sum3);
+    std::vector<std::array<Real, 5>> sections;
+    std::vector<std::vector<Real>> z; // per channel, two values per section
+    void reserve(size_t channels) { // before process, which only indexes z
+        if (z.size() < channels) z.resize(channels);
+        for (auto& zc : z) zc.resize(2 * sections.size(), 0);
+    }
+    void process(Real* x, size_t n, size_t ch) {
+        for (size_t s = 0; s < sections.size(); ++s) {
+            const std::array<Real, 5>& c = sections[s];
+            Real z1 = z[ch][2 * s], z2 = z[ch][2 * s + 1];
+            for (size_t i = 0; i < n; ++i) {
+                Real in = x[i], y = c[0] * in + z1;
+                z1 = c[1] * in - c[3] * y + z2;
+                z2 = c[2] * in - c[4] * y;
+                x[i] = y;
+            }
+            z[ch][2 * s] = z1;
+            z[ch][2 * s + 1] = z2;
+        }
+    }
+};
+std::array<Real, 5> pack_section(AtomPtr coeffs, AtomPtr node) {
+    Packed c = pack_vector(coeffs, node);
+    if (c.size() == 5) return {c[0], c[1], c[2], c[3], c[4]};
+    if (c.size() != 6 || c[3] == 0) error("a section needs (b0 b1 b2 a1 a2) or (b0 b1 b2 a0 a1 a2)", node);
+    return {c[0] / c[3], c[1] / c[3], c[2] / c[3], c[4] / c[3], c[5] / c[3]};
 }
-AtomPtr fn_writewav(AtomPtr node, AtomPtr env) {
-    std::string filename = type_check(node->tail.at(0), STRING)->lexeme;
-    AtomPtr data = type_check(node->tail.at(1), LIST);
-    uint16_t bits = 16;
-    uint32_t samplerate = 44100;
-    if (node->tail.size() >= 3) {
-        bits = static_cast<uint16_t>(type_check(node->tail.at(2), NUMBER)->value);
-        if (bits != 16 && bits != 32) error("bits must be 16 or 32", node);
+AtomPtr fn_filter_state(AtomPtr node, AtomPtr env) {
+    auto st = std::make_shared<FilterState>();
+    for (auto& s : type_check(node->tail.at(0), LIST)->tail) st->sections.push_back(pack_section(s, node));
+    if (st->sections.empty()) error("no filter sections", node);
+    return make_atom(st);
+}
+AtomPtr filter_sections(AtomPtr node, std::shared_ptr<FilterState> st) {
+    bool multi;
+    std::vector<std::vector<Real>> chans = pack_channels(node->tail.at(0), multi, node);
+    st->reserve(chans.size());
+    parallel_for(chans.size(), 1, [&](size_t b, size_t e) {
+        for (size_t ch = b; ch < e; ++ch) st->process(chans[ch].data(), chans[ch].size(), ch);
+    });
+    return unpack_channels(chans, multi);
+}
+AtomPtr fn_biquad(AtomPtr node, AtomPtr env) {
+    auto st = std::make_shared<FilterState>();
+    st->sections.push_back(pack_section(node->tail.at(1), node));
+    return filter_sections(node, st);
+}
+// (sos-filter signal sections) starts from silence, (sos-filter signal state)
+// continues from and updates a filter-state object
+AtomPtr fn_sos_filter(AtomPtr node, AtomPtr env) {
+    AtomPtr arg = node->tail.at(1);
+    if (arg->type == OBJECT) {
+        object_check<FilterState>(arg);
+        return filter_sections(node, std::static_pointer_cast<FilterState>(arg->obj));
     }
-    if (node->tail.size() >= 4) {
-        samplerate = static_cast<uint32_t>(type_check(node->tail.at(3), NUMBER)->value);
+    AtomPtr args = make_atom();
+    args->tail.push_back(arg);
+    return filter_sections(node, std::static_pointer_cast<FilterState>(fn_filter_state(args, env)->obj));
+}
+Real bessel_i0(Real x) {
+    Real sum = 1, term = 1;
+    for (int k = 1; k < 64 && term > sum * 1e-17; ++k) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+// (resample signal up down [half-length]): rational rate change by up/down
+// with a Kaiser-windowed sinc split into up polyphase branches, so only
+// the nonzero samples of the upsampled signal are ever multiplied
+AtomPtr fn_resample(AtomPtr node, AtomPtr env) {
+    bool multi;
+    std::vector<std::vector<Real>> chans = pack_channels(node->tail.at(0), multi, node);
+    long up = (long) type_check(node->tail.at(1), NUMBER)->value;
+    long down = (long) type_check(node->tail.at(2), NUMBER)->value;
+    if (up < 1 || down < 1) error("resampling factors must be positive integers", node);
+    long g = std::gcd(up, down);
+    up /= g;
+    down /= g;
+    long max_rate = std::max(up, down);
+    long half = (node->tail.size() > 3 ? (long) type_check(node->tail.at(3), NUMBER)->value : 10) * max_rate;
+    if (half < 1) error("filter half-length must be positive", node);
+    size_t len = 2 * half + 1, taps = (len + up - 1) / up;
+    const Real beta = 5.0, fc = 1.0 / max_rate;
+    std::vector<Real> h(taps * up, 0);
+    for (size_t k = 0; k < len; ++k) {
+        Real t = (Real) k - half, r = t / half;
+        Real sinc = t == 0 ? fc : std::sin(M_PI * fc * t) / (M_PI * t);
+        h[k] = sinc * bessel_i0(beta * std::sqrt(std::max<Real>(0, 1 - r * r)));
+    }
+    Real gain = std::accumulate(h.begin(), h.end(), (Real) 0);
+    for (auto& v : h) v *= up / gain; // unit gain at DC
+    // branch p holds h[p], h[p + up], ... reversed, to run against x forward
+    std::vector<Real> poly(taps * up);
+    for (long p = 0; p < up; ++p) {
+        for (size_t j = 0; j < taps; ++j) poly[p * taps + taps - 1 - j] = h[p + j * up];
+    }
+    for (auto& x : chans) {
+        size_t n = x.size(), out = (n * up + down - 1) / down;
+        size_t last = out ? ((out - 1) * down + half) / up : 0;
+        std::vector<Real> xp(taps + std::max(last + 1, n), 0);
+        std::copy(x.begin(), x.end(), xp.begin() + taps);
+        std::vector<Real> y(out);
+        parallel_for(out, 1 << 12, [&](size_t b, size_t e) {
+            for (size_t m = b; m < e; ++m) {
+                size_t t = m * down + half, base = t / up;
+                y[m] = dot_product(&poly[(t % up) * taps], &xp[taps + base + 1 - taps], taps);
+            }
+        });
+        x.swap(y);
+    }
+    return unpack_channels(chans, multi);
+}
+AtomPtr fn_matrix(AtomPtr node, AtomPtr env) {
+    if (node->tail.at(0)->type == NUMBER) {
+        args_check(node, 2);
+        Real r = type_check(node->tail.at(0), NUMBER)->value;
+        Real c = type_check(node->tail.at(1), NUMBER)->value;
+        if (r < 0 || c < 0) error("matrix: negative size", node);
+        Real fill = node->tail.size() > 2 ? type_check(node->tail.at(2), NUMBER)->value : 0;
+        return make_atom(std::make_shared<Matrix>((size_t) r, (size_t) c, fill));
     }
-    uint16_t channels = data->tail.size();
+    size_t rows = 0, cols = 0;
+    std::vector<Real> data = pack_rows(node->tail.at(0), rows, cols, node).take();
+    return make_matrix(rows, cols, std::move(data));
+}
+AtomPtr fn_matrix_to_list(AtomPtr node, AtomPtr env) {
+    Matrix* m = object_check<Matrix>(node->tail.at(0));
+    return unpack_rows(m->data.data(), m->rows, m->cols);
+}
+AtomPtr fn_matrix_shape(AtomPtr node, AtomPtr env) {
+    Matrix* m = object_check<Matrix>(node->tail.at(0));
+    AtomPtr r = make_atom();
+    r->tail.push_back(make_atom((Real) m->rows));
+    r->tail.push_back(make_atom((Real) m->cols));
+    return r;
+}
+AtomPtr fn_matrix_ref(AtomPtr node, AtomPtr env) {
+    Matrix* m = object_check<Matrix>(node->tail.at(0));
+    Real i = type_check(node->tail.at(1), NUMBER)->value;
+    Real j = type_check(node->tail.at(2), NUMBER)->value;
+    if (i < 0 || j < 0 || i >= m->rows || j >= m->cols) error("matrix-ref: index out of range", node);
+    return make_atom(m->data[(size_t) i * m->cols + (size_t) j]);
+}
+AtomPtr fn_matmul(AtomPtr node, AtomPtr env) {
+    size_t ar = 0, ac = 0, br = 0, bc = 0;
+    Packed a = pack_rows(node->tail.at(0), ar, ac, node);
+    Packed b = pack_rows(node->tail.at(1), br, bc, node);
+    if (ac != br) error("matmul: inner dimensions must agree", node);
+    std::vector<Real> c(ar * bc);
+    gemm(false, false, ar, bc, ac, 1.0, a.data(), b.data(), 0.0, c.data());
+    return make_matrix(ar, bc, std::move(c));
+}
+AtomPtr fn_transpose(AtomPtr node, AtomPtr env) {
+    size_t r = 0, c = 0;
+    Packed a = pack_rows(node->tail.at(0), r, c, node);
+    std::vector<Real> t(r * c);
+    const size_t B = 32; // tiles keep both sides in cache
+    parallel_for((r + B - 1) / B, 4, [&](size_t begin, size_t end) {
+        for (size_t i0 = begin * B; i0 < std::min(r, end * B); i0 += B) {
+            for (size_t j0 = 0; j0 < c; j0 += B) {
+                for (size_t i = i0; i < std::min(r, i0 + B); ++i) {
+                    for (size_t j = j0; j < std::min(c, j0 + B); ++j) t[j * r + i] = a[i * c + j];
+                }
+            }
+        }
+    });
+    return make_matrix(c, r, std::move(t));
+}
+AtomPtr fn_matvec(AtomPtr node, AtomPtr env) {
+    size_t r = 0, c = 0;
+    Packed m = pack_rows(node->tail.at(0), r, c, node);
+    Packed v = pack_vector(node->tail.at(1), node);
+    if (v.size() != c) error("matvec: dimension mismatch", node);
+    std::vector<Real> y(r);
+    parallel_for(r, std::max<size_t>(1, (1 << 14) / std::max<size_t>(c, 1)), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) y[i] = dot_product(&m[i * c], v.data(), c);
+    });
+    return unpack_vector(y.data(), r);
+}
+AtomPtr fn_outer(AtomPtr node, AtomPtr env) {
+    Packed u = pack_vector(node->tail.at(0), node);
+    Packed v = pack_vector(node->tail.at(1), node);
+    std::vector<Real> m(u.size() * v.size());
+    parallel_for(u.size(), std::max<size_t>(1, (1 << 14) / std::max<size_t>(v.size(), 1)), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            for (size_t j = 0; j < v.size(); ++j) m[i * v.size() + j] = u[i] * v[j];
+        }
+    });
+    return make_matrix(u.size(), v.size(), std::move(m));
+}
+// elementwise operation between two matrices of the same shape or a matrix and a number
+template <typename F>
+AtomPtr matrix_elementwise(AtomPtr node, F f) {
+    AtomPtr a = node->tail.at(0), b = node->tail.at(1);
+    if (a->type == NUMBER && b->type == NUMBER) return make_atom(f(a->value, b->value));
+    size_t r = 0, c = 0, r2 = 0, c2 = 0;
+    Packed x, y;
+    if (a->type != NUMBER) x = pack_rows(a, r, c, node);
+    if (b->type != NUMBER) y = pack_rows(b, r2, c2, node);
+    if (a->type == NUMBER) { r = r2; c = c2; }
+    else if (b->type != NUMBER && (r != r2 || c != c2)) error("matrix shapes must agree", node);
+    Real sa = a->type == NUMBER ? a->value : 0, sb = b->type == NUMBER ? b->value : 0;
+    std::vector<Real> out(r * c);
+    parallel_for(out.size(), 1 << 15, [&](size_t begin, size_t end) {
+        if (x.empty()) for (size_t i = begin; i < end; ++i) out[i] = f(sa, y[i]);
+        else if (y.empty()) for (size_t i = begin; i < end; ++i) out[i] = f(x[i], sb);
+        else for (size_t i = begin; i < end; ++i) out[i] = f(x[i], y[i]);
+    });
+    return make_matrix(r, c, std::move(out));
+}
+AtomPtr fn_matrix_add(AtomPtr node, AtomPtr env) {
+    return matrix_elementwise(node, [](Real a, Real b) { return a + b; });
+}
+AtomPtr fn_matrix_sub(AtomPtr node, AtomPtr env) {
+    return matrix_elementwise(node, [](Real a, Real b) { return a - b; });
+}
+AtomPtr fn_matrix_mul(AtomPtr node, AtomPtr env) {
+    return matrix_elementwise(node, [](Real a, Real b) { return a * b; });
+}
+AtomPtr fn_matrix_div(AtomPtr node, AtomPtr env) {
+    return matrix_elementwise(node, [](Real a, Real b) { return a / b; });
+}
+void write_wav(const std::string& filename, const std::vector<std::vector<Real>>& data,
+    uint16_t bits, uint32_t samplerate, AtomPtr node) {
+    uint16_t channels = data.size();
     if (channels == 0) error("empty channel list", node);
-    uint32_t samples = data->tail.at(0)->tail.size();
-    for (auto& chan : data->tail) {
-        if (chan->tail.size() != samples)
+    uint32_t samples = data.at(0).size();
+    for (auto& chan : data) {
+        if (chan.size() != samples)
             error("all channels must have same length", node);
     }
     uint32_t bytes_per_sample = bits / 8;
@@ -575,7 +2025,7 @@ AtomPtr fn_writewav(AtomPtr node, AtomPtr env) {
     file.write(reinterpret_cast<const char*>(&data_size), 4);
     for (size_t i = 0; i < samples; ++i) {
         for (size_t ch = 0; ch < channels; ++ch) {
-            Real v = type_check(data->tail.at(ch)->tail.at(i), NUMBER)->value;
+            Real v = data[ch][i];
             if (v > 1.0) v = 1.0;
             if (v < -1.0) v = -1.0;
             if (bits == 16) {
@@ -587,43 +2037,388 @@ AtomPtr fn_writewav(AtomPtr node, AtomPtr env) {
             }
         }
     }
-    return make_atom();
 }
-AtomPtr fn_readwav(AtomPtr node, AtomPtr env) {
-    std::string filename = type_check(node->tail.at(0), STRING)->lexeme;
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) error("cannot open WAV file", node);
+struct WavFormat {
+    uint16_t channels, bits;
+    uint32_t samplerate;
+    size_t samples;
+};
+WavFormat read_wav_header(std::istream& file, AtomPtr node) {
     char header[44];
     file.read(header, 44);
-    if (std::string(header, header+4) != "RIFF" || std::string(header+8, header+12) != "WAVE")
+    if (!file || std::string(header, header+4) != "RIFF" || std::string(header+8, header+12) != "WAVE")
         error("invalid WAV header", node);
-    uint16_t channels = *reinterpret_cast<uint16_t*>(header + 22);
-    // uint32_t samplerate = *reinterpret_cast<uint32_t*>(header + 24);
-    uint16_t bits = *reinterpret_cast<uint16_t*>(header + 34);
-    if (bits != 16 && bits != 32) error("only 16-bit or 32-bit PCM supported", node);
+    WavFormat f;
+    f.channels = *reinterpret_cast<uint16_t*>(header + 22);
+    f.samplerate = *reinterpret_cast<uint32_t*>(header + 24);
+    f.bits = *reinterpret_cast<uint16_t*>(header + 34);
+    if (f.bits != 16 && f.bits != 32) error("only 16-bit or 32-bit PCM supported", node);
+    if (f.channels == 0) error("invalid WAV header", node);
     uint32_t data_size = *reinterpret_cast<uint32_t*>(header + 40);
-    size_t samples = data_size / (channels * (bits / 8));
-    std::vector<std::vector<Real>> out(channels, std::vector<Real>(samples));
-    for (size_t i = 0; i < samples; ++i) {
-        for (size_t ch = 0; ch < channels; ++ch) {
-            if (bits == 16) {
+    f.samples = data_size / (f.channels * (f.bits / 8));
+    return f;
+}
+// reads frames [first, first + count) into out[ch][first...], stops early at
+// eof and returns the number of frames actually read
+size_t read_wav_frames(std::istream& file, const WavFormat& f, std::vector<std::vector<Real>>& out,
+    size_t first, size_t count) {
+    std::vector<char> raw(count * f.channels * (f.bits / 8));
+    file.read(raw.data(), raw.size());
+    size_t frames = file.gcount() / (f.channels * (f.bits / 8));
+    for (size_t i = 0; i < frames; ++i) {
+        for (size_t ch = 0; ch < f.channels; ++ch) {
+            size_t k = i * f.channels + ch;
+            if (f.bits == 16) {
                 int16_t sample;
-                file.read(reinterpret_cast<char*>(&sample), sizeof(sample));
-                out[ch][i] = sample / 32768.0;
-            } else if (bits == 32) {
+                std::memcpy(&sample, raw.data() + 2 * k, 2);
+                out[ch][first + i] = sample / 32768.0;
+            } else {
                 int32_t sample;
-                file.read(reinterpret_cast<char*>(&sample), sizeof(sample));
-                out[ch][i] = sample / 2147483648.0;
+                std::memcpy(&sample, raw.data() + 4 * k, 4);
+                out[ch][first + i] = sample / 2147483648.0;
             }
         }
     }
-    AtomPtr result = make_atom();
-    for (auto& chan : out) {
-        AtomPtr c = make_atom();
-        for (auto v : chan) c->tail.push_back(make_atom(v));
-        result->tail.push_back(c);
+    return frames;
+}
+std::vector<std::vector<Real>> read_wav(const std::string& filename, uint32_t& samplerate, AtomPtr node) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) error("cannot open WAV file", node);
+    WavFormat f = read_wav_header(file, node);
+    samplerate = f.samplerate;
+    std::vector<std::vector<Real>> out(f.channels, std::vector<Real>(f.samples));
+    read_wav_frames(file, f, out, 0, f.samples);
+    return out;
+}
+uint16_t wav_bits(AtomPtr node, size_t pos) {
+    if (node->tail.size() <= pos) return 16;
+    uint16_t bits = static_cast<uint16_t>(type_check(node->tail.at(pos), NUMBER)->value);
+    if (bits != 16 && bits != 32) error("bits must be 16 or 32", node);
+    return bits;
+}
+AtomPtr fn_writewav(AtomPtr node, AtomPtr env) {
+    std::string filename = type_check(node->tail.at(0), STRING)->lexeme;
+    AtomPtr data = type_check(node->tail.at(1), LIST);
+    uint16_t bits = wav_bits(node, 2);
+    uint32_t samplerate = 44100;
+    if (node->tail.size() >= 4) {
+        samplerate = static_cast<uint32_t>(type_check(node->tail.at(3), NUMBER)->value);
     }
-    return result;
+    std::vector<std::vector<Real>> chans;
+    for (auto& chan : data->tail) chans.push_back(pack_vector(chan, node).take());
+    write_wav(filename, chans, bits, samplerate, node);
+    return make_atom();
+}
+AtomPtr fn_readwav(AtomPtr node, AtomPtr env) {
+    std::string filename = type_check(node->tail.at(0), STRING)->lexeme;
+    uint32_t samplerate;
+    return unpack_channels(read_wav(filename, samplerate, node), true);
+}
+// (stream-wav filename [block]): successive blocks of block frames (default
+// 4096, the last one shorter) as channel lists, like readwav
+AtomPtr fn_stream_wav(AtomPtr node, AtomPtr env) {
+    std::string filename = type_check(node->tail.at(0), STRING)->lexeme;
+    Real block = node->tail.size() > 1 ? type_check(node->tail.at(1), NUMBER)->value : 4096;
+    if (block < 1) error("invalid block size", node);
+    return make_stream([=]() -> Generator {
+        auto file = std::make_shared<std::ifstream>(filename, std::ios::binary);
+        if (!*file) error("cannot open WAV file", node);
+        WavFormat f = read_wav_header(*file, node);
+        size_t pos = 0, n = (size_t) block;
+        std::vector<std::vector<Real>> buffer(f.channels, std::vector<Real>(n));
+        return [=](AtomPtr& out) mutable {
+            size_t want = std::min(n, f.samples - pos);
+            size_t count = want ? read_wav_frames(*file, f, buffer, 0, want) : 0;
+            if (count == 0) return false;
+            pos = count < want ? f.samples : pos + count; // truncated file: stop after this block
+            out = make_atom();
+            for (auto& c : buffer) {
+                AtomPtr l = make_atom();
+                l->tail.reserve(count);
+                for (size_t i = 0; i < count; ++i) l->tail.push_back(make_atom(c[i]));
+                out->tail.push_back(l);
+            }
+            return true;
+        };
+    });
+}
+// block-based DSP graph: nodes sum their inputs into a preallocated block
+// buffer and process it in place; compile() sorts the nodes and sizes every
+// buffer so that process() never touches the heap
+enum DspKind {DSP_INPUT, DSP_OUTPUT, DSP_GAIN, DSP_MIX, DSP_BIQUAD, DSP_DELAY, DSP_CONV};
+struct DspNode {
+    DspKind kind;
+    size_t channel = 0; // input/output
+    Real gain = 1;
+    std::vector<size_t> inputs;
+    std::vector<Real> buf;
+    FilterState filter;
+    std::vector<Real> ring; // delay line
+    size_t pos = 0;
+    // uniformly partitioned convolution (overlap-save, block size B, FFT 2B)
+    std::vector<Real> ir;
+    std::vector<Complex> parts, fdl, frame, acc; // IR spectra, input spectra history
+    size_t nparts = 0, head = 0;
+    std::vector<Real> last;
+};
+struct DspGraph : public Object {
+    static constexpr const char* NAME = "dsp-graph";
+    const char* name() const { return NAME; }
+    void print(std::ostream& out) const {
+        out << "<dsp-graph " << nodes.size() << " nodes, block " << block << ">";
+    }
+    size_t block;
+    Real samplerate;
+    std::vector<DspNode> nodes;
+    std::vector<size_t> order;
+    size_t in_channels = 0, out_channels = 0;
+    bool compiled = false;
+    void compile(AtomPtr node) {
+        std::vector<size_t> pending(nodes.size(), 0);
+        std::vector<std::vector<size_t>> users(nodes.size());
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            pending[i] = nodes[i].inputs.size();
+            for (size_t j : nodes[i].inputs) users[j].push_back(i);
+        }
+        order.clear();
+        for (size_t i = 0; i < nodes.size(); ++i) if (!pending[i]) order.push_back(i);
+        for (size_t k = 0; k < order.size(); ++k) {
+            for (size_t u : users[order[k]]) if (--pending[u] == 0) order.push_back(u);
+        }
+        if (order.size() != nodes.size()) error("dsp graph has a cycle", node);
+        in_channels = out_channels = 0;
+        for (auto& n : nodes) {
+            n.buf.assign(block, 0);
+            if (n.kind == DSP_INPUT) in_channels = std::max(in_channels, n.channel + 1);
+            if (n.kind == DSP_OUTPUT) out_channels = std::max(out_channels, n.channel + 1);
+            if (n.kind == DSP_BIQUAD) {
+                n.filter.z.clear();
+                n.filter.reserve(1);
+            }
+            if (n.kind == DSP_DELAY) {
+                std::fill(n.ring.begin(), n.ring.end(), 0);
+                n.pos = 0;
+            }
+            if (n.kind == DSP_CONV) {
+                if (!is_power_of_two(block)) error("convolution nodes need a power-of-two block size", node);
+                size_t fft = 2 * block;
+                n.nparts = std::max<size_t>(1, (n.ir.size() + block - 1) / block);
+                n.parts.assign(n.nparts * fft, 0);
+                for (size_t p = 0; p < n.nparts; ++p) {
+                    Complex* h = &n.parts[p * fft];
+                    for (size_t i = 0; i < block && p * block + i < n.ir.size(); ++i) h[i] = n.ir[p * block + i];
+                    fft_compute(h, fft, false);
+                }
+                n.fdl.assign(n.nparts * fft, 0);
+                n.frame.assign(fft, 0);
+                n.acc.assign(fft, 0);
+                n.last.assign(block, 0);
+                n.head = 0;
+            }
+        }
+        if (out_channels == 0) error("dsp graph has no output", node);
+        compiled = true;
+    }
+    // one block: in[c] and out[c] point to block samples of each channel
+    void process(const Real* const* in, Real* const* out) {
+        for (size_t id : order) {
+            DspNode& n = nodes[id];
+            Real* x = n.buf.data();
+            if (n.kind == DSP_INPUT) std::copy(in[n.channel], in[n.channel] + block, x);
+            else std::fill(x, x + block, 0);
+            for (size_t j : n.inputs) {
+                const Real* y = nodes[j].buf.data();
+                for (size_t i = 0; i < block; ++i) x[i] += y[i];
+            }
+            switch (n.kind) {
+                case DSP_GAIN: case DSP_MIX:
+                    for (size_t i = 0; i < block; ++i) x[i] *= n.gain;
+                    break;
+                case DSP_BIQUAD:
+                    n.filter.process(x, block, 0);
+                    break;
+                case DSP_DELAY:
+                    if (n.ring.empty()) break;
+                    for (size_t i = 0; i < block; ++i) {
+                        Real y = n.ring[n.pos];
+                        n.ring[n.pos] = x[i];
+                        x[i] = y;
+                        if (++n.pos == n.ring.size()) n.pos = 0;
+                    }
+                    break;
+                case DSP_CONV: {
+                    size_t fft = 2 * block;
+                    // spectrum of [previous block, current block] into the delay line
+                    Complex* X = &n.fdl[n.head * fft];
+                    for (size_t i = 0; i < block; ++i) {
+                        X[i] = n.last[i];
+                        X[block + i] = x[i];
+                    }
+                    std::copy(x, x + block, n.last.begin());
+                    fft_compute(X, fft, false);
+                    std::fill(n.acc.begin(), n.acc.end(), Complex(0));
+                    for (size_t p = 0; p < n.nparts; ++p) {
+                        const Complex* Xp = &n.fdl[((n.head + n.nparts - p) % n.nparts) * fft];
+                        const Complex* H = &n.parts[p * fft];
+                        for (size_t k = 0; k < fft; ++k) {
+                            n.acc[k] += Complex(Xp[k].real() * H[k].real() - Xp[k].imag() * H[k].imag(),
+                                Xp[k].real() * H[k].imag() + Xp[k].imag() * H[k].real());
+                        }
+                    }
+                    n.head = (n.head + 1) % n.nparts;
+                    fft_compute(n.acc.data(), fft, true);
+                    for (size_t i = 0; i < block; ++i) x[i] = n.acc[block + i].real();
+                    break;
+                }
+                case DSP_OUTPUT:
+                    for (size_t i = 0; i < block; ++i) out[n.channel][i] += x[i];
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    // whole signals, zero padded to a multiple of the block size
+    std::vector<std::vector<Real>> render(const std::vector<std::vector<Real>>& input, AtomPtr node) {
+        if (!compiled) compile(node);
+        if (input.size() < in_channels) error("not enough input channels for dsp graph", node);
+        size_t len = 0;
+        for (auto& c : input) len = std::max(len, c.size());
+        size_t blocks = (len + block - 1) / block;
+        std::vector<std::vector<Real>> padded(in_channels, std::vector<Real>(blocks * block, 0));
+        for (size_t c = 0; c < in_channels; ++c) std::copy(input[c].begin(), input[c].end(), padded[c].begin());
+        std::vector<std::vector<Real>> output(out_channels, std::vector<Real>(blocks * block, 0));
+        std::vector<const Real*> in(in_channels);
+        std::vector<Real*> out(out_channels);
+        for (size_t b = 0; b < blocks; ++b) {
+            for (size_t c = 0; c < in_channels; ++c) in[c] = &padded[c][b * block];
+            for (size_t c = 0; c < out_channels; ++c) out[c] = &output[c][b * block];
+            process(in.data(), out.data());
+        }
+        for (auto& c : output) c.resize(len);
+        return output;
+    }
+};
+AtomPtr fn_dsp_graph(AtomPtr node, AtomPtr env) {
+    auto g = std::make_shared<DspGraph>();
+    Real block = type_check(node->tail.at(0), NUMBER)->value;
+    if (block < 1) error("block size must be positive", node);
+    g->block = (size_t) block;
+    g->samplerate = node->tail.size() > 1 ? type_check(node->tail.at(1), NUMBER)->value : 44100;
+    return make_atom(g);
+}
+// (dsp-node graph kind args...) -> node id; kinds: input ch, output ch,
+// gain g, mix [g], biquad sections, delay samples, conv impulse-response
+AtomPtr fn_dsp_node(AtomPtr node, AtomPtr env) {
+    DspGraph* g = object_check<DspGraph>(node->tail.at(0));
+    std::string kind = type_check(node->tail.at(1), SYMBOL)->lexeme;
+    AtomPtr arg = node->tail.size() > 2 ? node->tail.at(2) : nullptr;
+    auto number = [&](Real fallback) {
+        return arg ? type_check(arg, NUMBER)->value : fallback;
+    };
+    DspNode n;
+    if (kind == "input" || kind == "output") {
+        n.kind = kind == "input" ? DSP_INPUT : DSP_OUTPUT;
+        Real ch = number(0);
+        if (ch < 0) error("invalid channel", node);
+        n.channel = (size_t) ch;
+    } else if (kind == "gain" || kind == "mix") {
+        n.kind = kind == "gain" ? DSP_GAIN : DSP_MIX;
+        if (kind == "gain" && !arg) error("gain node needs a value", node);
+        n.gain = number(1);
+    } else if (kind == "biquad") {
+        n.kind = DSP_BIQUAD;
+        if (!arg) error("biquad node needs sections", node);
+        AtomPtr sections = type_check(arg, LIST);
+        if (sections->tail.size() && sections->tail.at(0)->type == NUMBER) n.filter.sections.push_back(pack_section(sections, node));
+        else for (auto& sec : sections->tail) n.filter.sections.push_back(pack_section(sec, node));
+        if (n.filter.sections.empty()) error("no filter sections", node);
+    } else if (kind == "delay") {
+        n.kind = DSP_DELAY;
+        Real d = number(0);
+        if (d < 0) error("invalid delay", node);
+        n.ring.assign((size_t) d, 0);
+    } else if (kind == "conv") {
+        n.kind = DSP_CONV;
+        if (!arg) error("conv node needs an impulse response", node);
+        n.ir = pack_vector(arg, node).take();
+    } else error("unknown dsp node kind", node);
+    g->nodes.push_back(std::move(n));
+    g->compiled = false;
+    return make_atom((Real) g->nodes.size() - 1);
+}
+AtomPtr fn_dsp_connect(AtomPtr node, AtomPtr env) {
+    DspGraph* g = object_check<DspGraph>(node->tail.at(0));
+    for (size_t i = 1; i + 1 < node->tail.size(); ++i) {
+        Real from = type_check(node->tail.at(i), NUMBER)->value;
+        Real to = type_check(node->tail.at(i + 1), NUMBER)->value;
+        if (from < 0 || to < 0 || from >= g->nodes.size() || to >= g->nodes.size()) error("invalid dsp node", node);
+        if (g->nodes[(size_t) to].kind == DSP_INPUT) error("input nodes cannot have inputs", node);
+        g->nodes[(size_t) to].inputs.push_back((size_t) from);
+    }
+    g->compiled = false;
+    return make_atom();
+}
+// (dsp-render graph channels) -> channels, or
+// (dsp-render graph "in.wav" "out.wav" [bits]) for file-to-file rendering;
+// every render starts from cleared state
+AtomPtr fn_dsp_render(AtomPtr node, AtomPtr env) {
+    DspGraph* g = object_check<DspGraph>(node->tail.at(0));
+    g->compiled = false;
+    AtomPtr src = node->tail.at(1);
+    if (src->type == STRING) {
+        args_check(node, 3);
+        uint32_t samplerate;
+        std::vector<std::vector<Real>> input = read_wav(src->lexeme, samplerate, node);
+        std::string dest = type_check(node->tail.at(2), STRING)->lexeme;
+        write_wav(dest, g->render(input, node), wav_bits(node, 3), samplerate, node);
+        return make_atom();
+    }
+    bool multi;
+    std::vector<std::vector<Real>> input = pack_channels(src, multi, node);
+    return unpack_channels(g->render(input, node), true);
+}
+// (dsp-bench graph blocks) -> ((block-size B) (mean-us t) (max-us t) (realtime x))
+// on white noise input; realtime is block duration over mean processing time
+AtomPtr fn_dsp_bench(AtomPtr node, AtomPtr env) {
+    DspGraph* g = object_check<DspGraph>(node->tail.at(0));
+    Real count = type_check(node->tail.at(1), NUMBER)->value;
+    if (count < 1) error("need at least one block", node);
+    g->compile(node);
+    std::minstd_rand gen(1);
+    std::uniform_real_distribution<Real> noise(-1, 1);
+    std::vector<std::vector<Real>> input(g->in_channels, std::vector<Real>(g->block));
+    std::vector<std::vector<Real>> output(g->out_channels, std::vector<Real>(g->block));
+    std::vector<const Real*> in;
+    std::vector<Real*> out;
+    for (auto& c : input) in.push_back(c.data());
+    for (auto& c : output) out.push_back(c.data());
+    Real total = 0, worst = 0;
+    for (size_t b = 0; b < (size_t) count; ++b) {
+        for (auto& c : input) for (auto& v : c) v = noise(gen);
+        for (auto& c : output) std::fill(c.begin(), c.end(), 0);
+        auto t0 = std::chrono::steady_clock::now();
+        g->process(in.data(), out.data());
+        Real us = std::chrono::duration<Real, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        total += us;
+        worst = std::max(worst, us);
+    }
+    Real mean = total / (size_t) count;
+    return make_record({{"block-size", (Real) g->block}, {"mean-us", mean},
+        {"max-us", worst}, {"realtime", mean > 0 ? 1e6 * g->block / g->samplerate / mean : 0}});
+}
+AtomPtr parse_csv_row(const std::string& line) {
+    AtomPtr row = make_atom();
+    std::stringstream ss(line);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (is_number(item)) {
+            row->tail.push_back(make_atom(std::stod(item)));
+        } else {
+            row->tail.push_back(make_string(item));
+        }
+    }
+    return row;
 }
 AtomPtr fn_readcsv(AtomPtr node, AtomPtr env) {
     std::string filename = type_check(node->tail.at(0), STRING)->lexeme;
@@ -633,66 +2428,422 @@ AtomPtr fn_readcsv(AtomPtr node, AtomPtr env) {
     }
     AtomPtr result = make_atom();
     std::string line;
-    while (std::getline(file, line)) {
-        AtomPtr row = make_atom();
-        std::stringstream ss(line);
-        std::string item;
-        while (std::getline(ss, item, ',')) {
-            if (is_number(item)) {
-                row->tail.push_back(make_atom(std::stod(item)));
-            } else {
-                row->tail.push_back(make_atom('"' + item));
-            }
-        }
-        result->tail.push_back(row);
-    }
+    while (std::getline(file, line)) result->tail.push_back(parse_csv_row(line));
     return result;
 }
+// (stream-csv filename): rows parsed like readcsv, read as they are consumed
+AtomPtr fn_stream_csv(AtomPtr node, AtomPtr env) {
+    std::string filename = type_check(node->tail.at(0), STRING)->lexeme;
+    return make_stream([=]() -> Generator {
+        auto file = std::make_shared<std::ifstream>(filename);
+        if (!file->is_open()) error("cannot open file", node);
+        return [=](AtomPtr& out) {
+            std::string line;
+            if (!std::getline(*file, line)) return false;
+            out = parse_csv_row(line);
+            return true;
+        };
+    });
+}
+// numbers are written exactly (shortest round-trip form); a matrix is
+// written row by row
 AtomPtr fn_writecsv(AtomPtr node, AtomPtr env) {
     std::string filename = type_check(node->tail.at(0), STRING)->lexeme;
-    AtomPtr table = type_check(node->tail.at(1), LIST);
+    AtomPtr table = node->tail.at(1);
+    const Matrix* m = table->type == OBJECT ? dynamic_cast<const Matrix*>(table->obj.get()) : nullptr;
+    if (!m) type_check(table, LIST);
     std::ofstream file(filename);
     if (!file.is_open()) {
         error("cannot open file", node);
     }
-    for (const auto& row : table->tail) {
+    Writer w(file);
+    if (m) {
+        for (size_t i = 0; i < m->rows; ++i) {
+            for (size_t j = 0; j < m->cols; ++j) {
+                if (j) w.put(',');
+                w.number(m->data[i * m->cols + j]);
+            }
+            w.put('\n');
+        }
+    } else for (const auto& row : table->tail) {
         AtomPtr r = type_check(row, LIST);
         for (size_t i = 0; i < r->tail.size(); ++i) {
             if (r->tail[i]->type == NUMBER) {
-                file << r->tail[i]->value;
-            } else if (r->tail[i]->type == STRING) {
-                file << r->tail[i]->lexeme;
-            } else if (r->tail[i]->type == SYMBOL) {
-                file << r->tail[i]->lexeme;
+                w.number(r->tail[i]->value);
+            } else if (r->tail[i]->type == STRING || r->tail[i]->type == SYMBOL) {
+                w.put(r->tail[i]->lexeme);
             }
-            if (i != r->tail.size() - 1) file << ",";
+            if (i != r->tail.size() - 1) w.put(',');
         }
-        file << "\n";
+        w.put('\n');
     }
+    w.flush();
+    if (!file) error("cannot write file", node);
     return make_atom("");
 }
+struct MappedFile {
+    MappedFile(const std::string& filename) : data(nullptr), size(0) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                data = static_cast<const char*>(p);
+                size = st.st_size;
+                madvise(p, size, MADV_SEQUENTIAL);
+            }
+        }
+        ::close(fd);
+    }
+    ~MappedFile() {
+        if (data) munmap(const_cast<char*>(data), size);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    const char* data;
+    size_t size;
+};
+template <typename T>
+Real npy_load(const char* p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return static_cast<Real>(v);
+}
+template <typename T>
+void npy_store(char* p, Real v) {
+    T t = static_cast<T>(v);
+    std::memcpy(p, &t, sizeof(T));
+}
+typedef Real (*NpyLoader)(const char*);
+NpyLoader npy_loader(char kind, size_t bytes) {
+    if (kind == 'f' && bytes == 8) return &npy_load<double>;
+    if (kind == 'f' && bytes == 4) return &npy_load<float>;
+    if (kind == 'i' && bytes == 8) return &npy_load<int64_t>;
+    if (kind == 'i' && bytes == 4) return &npy_load<int32_t>;
+    if (kind == 'i' && bytes == 2) return &npy_load<int16_t>;
+    if (kind == 'i' && bytes == 1) return &npy_load<int8_t>;
+    if (kind == 'u' && bytes == 8) return &npy_load<uint64_t>;
+    if (kind == 'u' && bytes == 4) return &npy_load<uint32_t>;
+    if (kind == 'u' && bytes == 2) return &npy_load<uint16_t>;
+    if ((kind == 'u' || kind == 'b') && bytes == 1) return &npy_load<uint8_t>;
+    return nullptr;
+}
+// value of a key in the python dict literal of a .npy header
+std::string npy_field(const std::string& header, const std::string& key) {
+    size_t pos = header.find("'" + key + "'");
+    if (pos == std::string::npos) return "";
+    pos = header.find(':', pos);
+    if (pos == std::string::npos) return "";
+    ++pos;
+    while (pos < header.size() && header[pos] == ' ') ++pos;
+    size_t end = pos;
+    if (header[pos] == '(') end = header.find(')', pos) + 1;
+    else if (header[pos] == '\'') end = header.find('\'', pos + 1) + 1;
+    else end = header.find_first_of(",}", pos);
+    if (end == std::string::npos || end <= pos) return "";
+    return header.substr(pos, end - pos);
+}
+AtomPtr fn_npy_read(AtomPtr node, AtomPtr env) {
+    std::string filename = type_check(node->tail.at(0), STRING)->lexeme;
+    MappedFile file(filename);
+    if (!file.data) error("cannot open NPY file", node);
+    if (file.size < 10 || std::memcmp(file.data, "\x93NUMPY", 6) != 0) error("invalid NPY header", node);
+    unsigned char major = file.data[6];
+    size_t header_len = 0, offset = 0;
+    if (major == 1) {
+        header_len = (unsigned char) file.data[8] | ((unsigned char) file.data[9] << 8);
+        offset = 10;
+    } else if (major == 2 || major == 3) {
+        if (file.size < 12) error("invalid NPY header", node);
+        for (int i = 3; i >= 0; --i) header_len = (header_len << 8) | (unsigned char) file.data[8 + i];
+        offset = 12;
+    } else error("unsupported NPY version", node);
+    if (offset + header_len > file.size) error("truncated NPY header", node);
+    std::string header(file.data + offset, header_len);
+    offset += header_len;
+
+    std::string descr = npy_field(header, "descr");
+    if (descr.size() < 5) error("unsupported NPY dtype", node);
+    char order = descr[1], kind = descr[2];
+    size_t bytes = std::atoi(descr.substr(3, descr.size() - 4).c_str());
+    if (order == '>' && bytes > 1) error("big-endian NPY data not supported", node);
+    NpyLoader load = npy_loader(kind, bytes);
+    if (!load) error("unsupported NPY dtype " + descr, node);
+    if (npy_field(header, "fortran_order") == "True") error("only C-order NPY arrays are supported", node);
+
+    std::vector<size_t> shape;
+    std::string dims = npy_field(header, "shape");
+    std::stringstream ss(dims.substr(1, dims.size() > 2 ? dims.size() - 2 : 0));
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.find_first_not_of(' ') == std::string::npos) continue;
+        long d = std::atol(item.c_str());
+        if (d < 0) error("invalid NPY shape", node);
+        shape.push_back(d);
+    }
+    if (shape.size() > 2) error("only 1-D and 2-D NPY arrays are supported", node);
+    size_t rows = shape.size() ? shape[0] : 1;
+    size_t cols = shape.size() == 2 ? shape[1] : 1;
+    if (cols && rows > SIZE_MAX / cols) error("invalid NPY shape", node);
+    if (rows * cols > (file.size - offset) / bytes) error("truncated NPY data", node);
+
+    // elements are converted straight from the mapped pages, no intermediate copy
+    const char* p = file.data + offset;
+    if (node->tail.size() > 1 && type_check(node->tail.at(1), SYMBOL)->lexeme == "matrix") {
+        if (shape.size() < 2) cols = rows, rows = 1;
+        if (shape.empty()) cols = 1;
+        std::vector<Real> data(rows * cols);
+        if (kind == 'f' && bytes == sizeof(Real)) std::memcpy(data.data(), p, data.size() * bytes);
+        else for (size_t i = 0; i < data.size(); ++i, p += bytes) data[i] = load(p);
+        return make_matrix(rows, cols, std::move(data));
+    }
+    if (shape.empty()) return make_atom(load(p));
+    AtomPtr result = make_atom();
+    result->tail.reserve(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        if (shape.size() == 1) {
+            result->tail.push_back(make_atom(load(p)));
+            p += bytes;
+            continue;
+        }
+        AtomPtr row = make_atom();
+        row->tail.reserve(cols);
+        for (size_t j = 0; j < cols; ++j, p += bytes) row->tail.push_back(make_atom(load(p)));
+        result->tail.push_back(row);
+    }
+    return result;
+}
+AtomPtr fn_npy_write(AtomPtr node, AtomPtr env) {
+    std::string filename = type_check(node->tail.at(0), STRING)->lexeme;
+    AtomPtr data = node->tail.at(1);
+    std::string dtype = "f8";
+    if (node->tail.size() >= 3) {
+        dtype = type_check(node->tail.at(2), STRING)->lexeme;
+        if (dtype.size() && (dtype[0] == '<' || dtype[0] == '|')) dtype = dtype.substr(1);
+    }
+    void (*store)(char*, Real) = nullptr;
+    if (dtype == "f8" || dtype == "float64") { dtype = "f8"; store = &npy_store<double>; }
+    else if (dtype == "f4" || dtype == "float32") { dtype = "f4"; store = &npy_store<float>; }
+    else if (dtype == "i8" || dtype == "int64") { dtype = "i8"; store = &npy_store<int64_t>; }
+    else if (dtype == "i4" || dtype == "int32") { dtype = "i4"; store = &npy_store<int32_t>; }
+    else error("npy-write: dtype must be f8, f4, i8 or i4", node);
+    size_t bytes = dtype[1] - '0';
+
+    bool is_2d = is_matrix(data) || (type_check(data, LIST)->tail.size() > 0 && data->tail.at(0)->type == LIST);
+    size_t rows = 0, cols = 0;
+    Packed values = pack_rows(data, rows, cols, node);
+    std::string shape = is_2d ? "(" + std::to_string(rows) + ", " + std::to_string(cols) + ")"
+        : "(" + std::to_string(rows) + ",)";
+    std::string header = "{'descr': '<" + dtype + "', 'fortran_order': False, 'shape': " + shape + ", }";
+    size_t total = 10 + header.size() + 1;
+    header.append((64 - total % 64) % 64, ' ');
+    header += '\n';
+
+    std::vector<char> buffer(10 + header.size() + rows * cols * bytes);
+    std::memcpy(buffer.data(), "\x93NUMPY\x01\x00", 8);
+    buffer[8] = header.size() & 0xff;
+    buffer[9] = (header.size() >> 8) & 0xff;
+    std::memcpy(buffer.data() + 10, header.data(), header.size());
+    char* p = buffer.data() + 10 + header.size();
+    for (Real v : values) {
+        store(p, v);
+        p += bytes;
+    }
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) error("cannot create NPY file", node);
+    file.write(buffer.data(), buffer.size());
+    return make_atom();
+}
+// model files: "SNIPMODL", u32 version, u32 kind, then the payload;
+// all integers and float64 values are little-endian
+const char MODEL_MAGIC[] = "SNIPMODL";
+const uint32_t MODEL_VERSION = 1;
+enum ModelKind {MODEL_NN = 1, MODEL_LINREG = 2, MODEL_MATRIX = 3};
+struct ModelWriter {
+    std::vector<char> buffer;
+    template <typename T>
+    void put(T v) {
+        char b[sizeof(T)];
+        std::memcpy(b, &v, sizeof(T));
+        if (std::endian::native == std::endian::big) std::reverse(b, b + sizeof(T));
+        buffer.insert(buffer.end(), b, b + sizeof(T));
+    }
+    void put(const std::vector<Real>& v) {
+        if (std::endian::native == std::endian::little) {
+            const char* p = reinterpret_cast<const char*>(v.data());
+            buffer.insert(buffer.end(), p, p + v.size() * sizeof(Real));
+        } else for (Real r : v) put(r);
+    }
+};
+struct ModelReader {
+    const char* p;
+    const char* end;
+    AtomPtr node;
+    template <typename T>
+    T get() {
+        if ((size_t) (end - p) < sizeof(T)) error("truncated model file", node);
+        char b[sizeof(T)];
+        std::memcpy(b, p, sizeof(T));
+        if (std::endian::native == std::endian::big) std::reverse(b, b + sizeof(T));
+        p += sizeof(T);
+        T v;
+        std::memcpy(&v, b, sizeof(T));
+        return v;
+    }
+    void get(std::vector<Real>& v, size_t n) {
+        if ((size_t) (end - p) / sizeof(Real) < n) error("truncated model file", node);
+        v.resize(n);
+        if (std::endian::native == std::endian::little) {
+            std::memcpy(v.data(), p, n * sizeof(Real));
+            p += n * sizeof(Real);
+        } else for (auto& r : v) r = get<Real>();
+    }
+};
+AtomPtr fn_model_save(AtomPtr node, AtomPtr env) {
+    std::string filename = type_check(node->tail.at(0), STRING)->lexeme;
+    AtomPtr model = node->tail.at(1);
+    ModelWriter w;
+    w.buffer.insert(w.buffer.end(), MODEL_MAGIC, MODEL_MAGIC + 8);
+    w.put<uint32_t>(MODEL_VERSION);
+    if (model->type == LIST) { // linreg model: slopes then intercept
+        Packed coeffs = pack_vector(model, node);
+        w.put<uint32_t>(MODEL_LINREG);
+        w.put<uint64_t>(coeffs.size());
+        w.put(coeffs.vec());
+    } else if (is_matrix(model)) {
+        Matrix* m = object_check<Matrix>(model);
+        w.put<uint32_t>(MODEL_MATRIX);
+        w.put<uint64_t>(m->rows);
+        w.put<uint64_t>(m->cols);
+        w.put(m->data);
+    } else {
+        NeuralNet* net = object_check<NeuralNet>(model);
+        w.put<uint32_t>(MODEL_NN);
+        w.put<uint32_t>(net->layers.size());
+        for (auto& l : net->layers) {
+            w.put<uint32_t>(l.in);
+            w.put<uint32_t>(l.out);
+            w.put<uint32_t>(l.act);
+            w.put(l.W);
+            w.put(l.b);
+        }
+    }
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) error("cannot create model file", node);
+    file.write(w.buffer.data(), w.buffer.size());
+    return make_atom();
+}
+AtomPtr fn_model_load(AtomPtr node, AtomPtr env) {
+    std::string filename = type_check(node->tail.at(0), STRING)->lexeme;
+    MappedFile file(filename);
+    if (!file.data) error("cannot open model file", node);
+    if (file.size < 16 || std::memcmp(file.data, MODEL_MAGIC, 8) != 0) error("invalid model file", node);
+    ModelReader r = {file.data + 8, file.data + file.size, node};
+    if (r.get<uint32_t>() != MODEL_VERSION) error("unsupported model file version", node);
+    uint32_t kind = r.get<uint32_t>();
+    if (kind == MODEL_LINREG) {
+        std::vector<Real> coeffs;
+        r.get(coeffs, r.get<uint64_t>());
+        return unpack_vector(coeffs.data(), coeffs.size());
+    } else if (kind == MODEL_MATRIX) {
+        uint64_t rows = r.get<uint64_t>(), cols = r.get<uint64_t>();
+        if (cols != 0 && rows > SIZE_MAX / cols) error("invalid matrix size in model file", node);
+        if (rows * cols > (size_t) (r.end - r.p) / sizeof(Real)) error("truncated model file", node);
+        std::vector<Real> data;
+        r.get(data, rows * cols);
+        return make_matrix(rows, cols, std::move(data));
+    } else if (kind == MODEL_NN) {
+        auto net = std::make_shared<NeuralNet>();
+        uint32_t layers = r.get<uint32_t>();
+        for (uint32_t i = 0; i < layers; ++i) {
+            NeuralNet::Layer l;
+            l.in = r.get<uint32_t>();
+            l.out = r.get<uint32_t>();
+            uint32_t act = r.get<uint32_t>();
+            if (act > SOFTMAX) error("unknown activation in model file", node);
+            if (i > 0 && l.in != net->layers.back().out) error("inconsistent layer sizes in model file", node);
+            l.act = (Activation) act;
+            r.get(l.W, (size_t) l.in * l.out);
+            r.get(l.b, l.out);
+            net->layers.push_back(std::move(l));
+        }
+        if (net->layers.empty()) error("empty network in model file", node);
+        return make_atom(net);
+    }
+    error("unknown model kind", node);
+    return make_atom(); // dummy
+}
 void add_scientific (AtomPtr env) {
     add_op ("mean", &fn_mean, 1, env);
 	add_op ("variance", &fn_variance, 1, env);
 	add_op ("stddev", &fn_stddev, 1, env);
+	add_op ("stats-new", &fn_stats_new, 0, env);
+	add_op ("stats-push", &fn_stats_push, 2, env);
+	add_op ("stats-merge", &fn_stats_merge, 1, env);
+	add_op ("describe", &fn_describe, 1, env);
+	add_op ("sort", &fn_sort, 1, env);
+	add_op ("argsort", &fn_argsort, 1, env);
+	add_op ("median", &fn_median, 1, env);
+	add_op ("quantile", &fn_quantile, 2, env);
+	add_op ("minmax", &fn_minmax, 1, env);
+	add_op ("histogram", &fn_histogram, 2, env);
 	add_op ("distance", &fn_distance, 2, env);
+	add_op ("random-uniform", &fn_random_uniform, 1, env);
+	add_op ("random-normal", &fn_random_normal, 1, env);
+	add_op ("random-int", &fn_random_int, 3, env);
+	add_op ("pdist", &fn_pdist, 1, env);
+	add_op ("cdist", &fn_cdist, 2, env);
 	add_op ("kmeans", &fn_kmeans, 2, env);
 	add_op ("linreg", &fn_linear_regression, 2, env);
 	add_op ("linreg-predict", &fn_predict_linear, 2, env);
+	add_op ("linreg-update", &fn_linreg_update, 3, env);
+	add_op ("linreg-solve", &fn_linreg_solve, 1, env);
 	add_op ("knn", &fn_knn, 4, env);	
+	add_op ("knn-index", &fn_knn_index, 2, env);
+	add_op ("knn-query", &fn_knn_query, 3, env);
     add_op ("nn-init", &fn_nn_init, 2, env);
     add_op ("nn-predict", &fn_nn_predict, 2, env);	
     add_op ("nn-train", &fn_nn_train, 4, env);	
+    add_op ("nn-fit", &fn_nn_fit, 5, env);
 	add_op ("fft", &fn_fft, 1, env);
 	add_op ("ifft", &fn_ifft, 1, env);
 	add_op ("conv", &fn_conv, 2, env);
 	add_op ("dot", &fn_dot, 2, env);
+	add_op ("fir", &fn_fir, 2, env);
+	add_op ("biquad", &fn_biquad, 2, env);
+	add_op ("filter-state", &fn_filter_state, 1, env);
+	add_op ("sos-filter", &fn_sos_filter, 2, env);
+	add_op ("resample", &fn_resample, 3, env);
+	add_op ("matrix", &fn_matrix, 1, env);
+	add_op ("matrix->list", &fn_matrix_to_list, 1, env);
+	add_op ("matrix-shape", &fn_matrix_shape, 1, env);
+	add_op ("matrix-ref", &fn_matrix_ref, 3, env);
+	add_op ("matmul", &fn_matmul, 2, env);
+	add_op ("transpose", &fn_transpose, 1, env);
+	add_op ("matvec", &fn_matvec, 2, env);
+	add_op ("outer", &fn_outer, 2, env);
+	add_op ("matrix-add", &fn_matrix_add, 2, env);
+	add_op ("matrix-sub", &fn_matrix_sub, 2, env);
+	add_op ("matrix-mul", &fn_matrix_mul, 2, env);
+	add_op ("matrix-div", &fn_matrix_div, 2, env);
 	add_op ("pol2car", &fn_pol2car, 1, env);
 	add_op ("car2pol", &fn_car2pol, 1, env);	
 	add_op ("readwav", &fn_readwav, 1, env);
+	add_op ("stream-wav", &fn_stream_wav, 1, env);
+	add_op ("dsp-graph", &fn_dsp_graph, 1, env);
+	add_op ("dsp-node", &fn_dsp_node, 2, env);
+	add_op ("dsp-connect", &fn_dsp_connect, 3, env);
+	add_op ("dsp-render", &fn_dsp_render, 2, env);
+	add_op ("dsp-bench", &fn_dsp_bench, 2, env);
 	add_op ("writewav", &fn_writewav, 3, env);
 	add_op ("readcsv", &fn_readcsv, 1, env);
+	add_op ("stream-csv", &fn_stream_csv, 1, env);
 	add_op ("writecsv", &fn_writecsv, 2, env);
+	add_op ("npy-read", &fn_npy_read, 1, env);
+	add_op ("npy-write", &fn_npy_write, 2, env);
+	add_op ("model-save", &fn_model_save, 2, env);
+	add_op ("model-load", &fn_model_load, 1, env);
 }
 #endif // SCILIB_h
 
@@ -1,6 +1,13 @@
 // snip.cpp
 //
 #include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 #include "snip.h"
 #include "scientific.h"
 
@@ -11,12 +18,199 @@ using namespace std;
 // - sintassi multipla? complica molto?
 // - plotting?
 // - NN?
-// 
+//
 
 // BUGS:
 // - se display non finisce, non è segnalato errore; va bene?
 
+// --- server mode ---
+//
+// snip --serve <socket> [files...] keeps one warm interpreter per core (files
+// are loaded once into each) behind a unix socket. A connection sends requests
+//   EVAL <timeout-ms> <bytes>\n<script>   or   LOAD <timeout-ms> <bytes>\n<path>
+// (timeout 0 = none) and gets back, per request, OUT frames as output is
+// produced followed by one RESULT or ERROR frame, all as <TAG> <bytes>\n<data>.
+// Each request runs in a fresh child of the warm global environment.
+
+bool send_all (int fd, const char* data, size_t n) {
+	while (n) {
+		ssize_t w = send (fd, data, n, MSG_NOSIGNAL);
+		if (w <= 0) return false;
+		data += w;
+		n -= w;
+	}
+	return true;
+}
+bool send_frame (int fd, const string& tag, const char* data, size_t n) {
+	string header = tag + " " + to_string (n) + "\n";
+	return send_all (fd, header.data (), header.size ()) && send_all (fd, data, n);
+}
+struct FrameBuf : public streambuf { // display output streamed as OUT frames
+	int fd;
+	char buffer[4096];
+	FrameBuf (int f) : fd (f) { setp (buffer, buffer + sizeof (buffer)); }
+	int sync () {
+		if (pptr () > pbase ()) send_frame (fd, "OUT", pbase (), pptr () - pbase ());
+		setp (buffer, buffer + sizeof (buffer));
+		return 0;
+	}
+	int overflow (int c) {
+		sync ();
+		if (c != EOF) sputc (c);
+		return c;
+	}
+};
+struct FdReader {
+	int fd;
+	char buffer[4096];
+	size_t pos = 0, len = 0;
+	bool get (char& c) {
+		if (pos == len) {
+			ssize_t r = recv (fd, buffer, sizeof (buffer), 0);
+			if (r <= 0) return false;
+			pos = 0;
+			len = r;
+		}
+		c = buffer[pos++];
+		return true;
+	}
+	bool line (string& s) {
+		s.clear ();
+		char c;
+		while (get (c) && c != '\n') s += c;
+		return c == '\n';
+	}
+	bool bytes (string& s, size_t n) {
+		s.resize (n);
+		for (size_t i = 0; i < n; ++i) if (!get (s[i])) return false;
+		return true;
+	}
+};
+AtomPtr eval_all (istream& in, AtomPtr env) { // stops at the first error
+	AtomPtr r = make_atom ();
+	unsigned linenum = 0;
+	while (!in.eof ()) {
+		AtomPtr l = read (in, linenum);
+		if (!in.eof ()) r = eval (l, env);
+	}
+	return r;
+}
+// each request evaluates in a fresh child of the worker's global environment,
+// so its defines vanish with it; set!, vector-set! or hash-set! applied to a
+// value bound in the global environment do persist into later requests on
+// the same worker. The deadline is checked at each evaluation step, so a
+// single long native primitive (a big fft, a file read) runs to completion
+const size_t max_request = 16 << 20; // bytes; larger payloads are malformed
+void serve_connection (int fd, AtomPtr global) {
+	FdReader reader {fd};
+	string header, payload;
+	while (reader.line (header)) {
+		string kind;
+		long timeout = 0;
+		size_t size = 0;
+		bool valid = false;
+		try {
+			istringstream h (header);
+			valid = (h >> kind >> timeout >> size) && (kind == "EVAL" || kind == "LOAD")
+				&& size <= max_request && reader.bytes (payload, size);
+		} catch (exception&) {
+			valid = false;
+		}
+		if (!valid) {
+			string msg = "malformed request";
+			send_frame (fd, "ERROR", msg.data (), msg.size ());
+			return;
+		}
+		FrameBuf buf (fd);
+		ostream out (&buf);
+		output = &out;
+		deadline_set = timeout > 0;
+		deadline = chrono::steady_clock::now () + chrono::milliseconds (timeout);
+		string tag = "RESULT", reply;
+		try {
+			AtomPtr env = make_atom ();
+			env->tail.push_back (global); // parent
+			AtomPtr r;
+			if (kind == "LOAD") {
+				ifstream in (payload);
+				if (!in.good ()) error ("cannot open input file", make_string (payload));
+				r = eval_all (in, env);
+			} else {
+				istringstream in (payload + "\n"); // a last token still ends before eof
+				r = eval_all (in, env);
+			}
+			ostringstream res;
+			print (r, res, true);
+			reply = res.str ();
+		} catch (exception& e) {
+			tag = "ERROR";
+			reply = e.what ();
+		}
+		out.flush ();
+		output = &cout;
+		deadline_set = false;
+		eval_stack.clear ();
+		if (!send_frame (fd, tag, reply.data (), reply.size ())) return;
+	}
+}
+int serve (const string& path, const vector<string>& preload) {
+	int server = socket (AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	if (server < 0 || path.size () >= sizeof (addr.sun_path)) {
+		cerr << "error: cannot create socket " << path << endl;
+		return 1;
+	}
+	strncpy (addr.sun_path, path.c_str (), sizeof (addr.sun_path) - 1);
+	unlink (path.c_str ());
+	if (bind (server, (sockaddr*) &addr, sizeof (addr)) < 0 || listen (server, 64) < 0) {
+		cerr << "error: cannot listen on " << path << endl;
+		return 1;
+	}
+	mutex lock;
+	condition_variable ready;
+	queue<int> pending;
+	unsigned workers = max (1u, thread::hardware_concurrency ());
+	for (unsigned i = 0; i < workers; ++i) {
+		thread ([&] {
+			AtomPtr env = make_env ();
+			add_scientific (env);
+			for (auto& f : preload) {
+				ifstream in (f);
+				if (!in.good ()) cerr << "warning: cannot open " << f << endl;
+				else load (f, in, env);
+			}
+			while (true) {
+				unique_lock<mutex> guard (lock);
+				ready.wait (guard, [&] { return !pending.empty (); });
+				int fd = pending.front ();
+				pending.pop ();
+				guard.unlock ();
+				try {
+					serve_connection (fd, env);
+				} catch (exception& e) { // a failing client must not take the worker down
+					cerr << "warning: " << e.what () << endl;
+				}
+				close (fd);
+			}
+		}).detach ();
+	}
+	cout << "[snip, serving on " << path << " with " << workers << " interpreters]" << endl;
+	while (true) {
+		int fd = accept (server, nullptr, nullptr);
+		if (fd < 0) continue;
+		lock_guard<mutex> guard (lock);
+		pending.push (fd);
+		ready.notify_one ();
+	}
+	return 0;
+}
+
 int main (int argc, char* argv[]) {
+	if (argc > 2 && string (argv[1]) == "--serve") {
+		return serve (argv[2], vector<string> (argv + 3, argv + argc));
+	}
+
 	AtomPtr env = make_env ();
 	add_scientific (env);
 
@@ -24,14 +218,14 @@ int main (int argc, char* argv[]) {
 		cout << "[snip, v. 0.1]" << endl << endl;
 		cout << "scheme nano-interpreter project" << endl;
 		cout << "(c) 2025 by Carmine-Emanuele Cella" << endl << endl;
-	
+
 		repl (cin, cout, env);
 	} else {
 		AtomPtr r;
 		for (int i = 1; i < argc; ++i) {
-			ifstream in (argv[1]);
+			ifstream in (argv[i]);
 			if (!in.good ()) cout << "warning: cannot open " << argv[i] << endl;
-			load (argv[1], in, env);
+			load (argv[i], in, env);
 		}
 	}
 	return 0;
@@ -14,6 +14,20 @@
 #include <iomanip>
 #include <random>
 #include <cmath>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <functional>
+#include <filesystem>
+#include <thread>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <shared_mutex>
+#include <charconv>
 
 // ast
 struct Atom;
@@ -21,19 +35,28 @@ typedef std::shared_ptr<Atom> AtomPtr;
 typedef double Real;
 typedef AtomPtr (*Functor) (AtomPtr, AtomPtr);
 inline thread_local std::vector<AtomPtr> eval_stack; // call stack
-struct StackGuard {
-    StackGuard(AtomPtr node) {
-        eval_stack.push_back(node);
-    }
-    ~StackGuard() {
-        eval_stack.pop_back();
-    }
-};
+inline thread_local std::ostream* output = &std::cout; // where display writes
+inline thread_local bool deadline_set = false; // optional time limit on evaluation
+inline thread_local std::chrono::steady_clock::time_point deadline;
+inline thread_local unsigned eval_ticks = 0;
+inline std::atomic<size_t> stack_limit {1000000}; // pending evaluations before "stack overflow"
 #define make_atom(a)(std::make_shared<Atom> (a))
-enum AtomType {LIST, SYMBOL, STRING, NUMBER, LAMBDA, MACRO, OP};
-const char* ATOM_NAMES[] = {"list", "symbol", "string", "number", "lambda", "macro", "op"};
+enum AtomType {LIST, SYMBOL, STRING, NUMBER, LAMBDA, MACRO, OP, OBJECT};
+const char* ATOM_NAMES[] = {"list", "symbol", "string", "number", "lambda", "macro", "op", "object"};
 bool is_string (const std::string& l);
 void error (const std::string& msg, AtomPtr n);
+struct Object { // native data owned by an atom (extensions derive from this)
+	virtual ~Object () {}
+	virtual const char* name () const = 0;
+	virtual void print (std::ostream& out) const { out << "<" << name () << ">"; }
+	// objects usable in call position: apply returns the result, or nullptr
+	// after setting next to a function that eval applies to the same arguments
+	// in its place, handing the outcome to complete
+	virtual bool callable () const { return false; }
+	virtual AtomPtr apply (AtomPtr args, AtomPtr node, AtomPtr env, AtomPtr& next) { return nullptr; }
+	virtual void complete (AtomPtr args, AtomPtr result) {}
+};
+typedef std::shared_ptr<Object> ObjectPtr;
 struct Atom {
 	Atom () { type = LIST; }
 	Atom (std::string lex) {
@@ -60,14 +83,37 @@ struct Atom {
 		type = OP;
 		op = f;
 	}
+	Atom (ObjectPtr o) {
+		type = OBJECT;
+		obj = o;
+	}
+	~Atom () { // sole owners of children are released in a loop, not recursively
+		if (tail.empty ()) return;
+		static thread_local bool draining = false, exited = false;
+		struct Doomed { // always empty between destructions; once it is gone at thread
+			std::vector<AtomPtr> atoms; // exit, later thread_locals free their atoms recursively
+			~Doomed () { exited = true; }
+		};
+		if (exited) return;
+		static thread_local Doomed doomed;
+		for (auto& t : tail) if (t.use_count () == 1) doomed.atoms.push_back (std::move (t));
+		if (draining) return;
+		draining = true;
+		while (doomed.atoms.size ()) {
+			AtomPtr a = std::move (doomed.atoms.back ());
+			doomed.atoms.pop_back ();
+		}
+		draining = false;
+	}
 	AtomType type;
 	std::string lexeme;
 	Real value;
 	Functor op;
 	unsigned minargs;
 	std::vector <AtomPtr> tail;
+	ObjectPtr obj;
 };
-bool is_nil (AtomPtr e) {
+bool is_nil (const AtomPtr& e) {
 	return (e == nullptr || (e->type == LIST && e->tail.size () == 0));
 }
 
@@ -76,6 +122,12 @@ bool is_string (const std::string& l) {
 	if (l.size () > 1 && l.at (0) == '\"') return true;
 	return false;
 }
+AtomPtr make_string (std::string s) { // STRING atom from raw contents
+	AtomPtr a = make_atom ();
+	a->type = STRING;
+	a->lexeme = std::move (s);
+	return a;
+}
 // bool is_number (std::string token) {
 // 	return std::regex_match(token, std::regex (("((\\+|-)?[[:digit:]]+)(\\.(([[:digit:]]+)?))?")));
 // }
@@ -86,39 +138,96 @@ bool is_number (const std::string& tt) {
 	Real v; dummy >> v;
 	return dummy && dummy.eof ();
 }
-std::ostream& print (AtomPtr e, std::ostream& out, bool write = false) {
-	if (e != nullptr) { // to have () printed for nil
-		switch (e->type) {
-		case LIST:
-			out << "(";
-			for (unsigned i = 0; i < e->tail.size (); ++i) {
-				print (e->tail.at (i), out, write);
-				if (i != e->tail.size () - 1) out << " ";
+// output: numbers are formatted with to_chars in the shortest form that reads
+// back to the same double, and text is batched in a 64 KB buffer that is
+// handed to the stream in large writes
+size_t format_number (char* buf, Real v) { // buf holds at least 32 chars
+	Real m = std::abs (v);
+	if (m == 0 || (m >= 1e-5 && m < 1e16)) { // 100000 rather than 1e+05
+		return std::to_chars (buf, buf + 32, v, std::chars_format::fixed).ptr - buf;
+	}
+	return std::to_chars (buf, buf + 32, v).ptr - buf;
+}
+struct Writer {
+	static const size_t CAPACITY = 1 << 16;
+	Writer (std::ostream& o) : out (o) { buffer.reserve (CAPACITY); }
+	~Writer () { flush (); }
+	void flush () {
+		if (buffer.size ()) out.write (buffer.data (), buffer.size ());
+		buffer.clear ();
+	}
+	void put (const char* s, size_t n) {
+		buffer.append (s, n);
+		if (buffer.size () >= CAPACITY) flush ();
+	}
+	void put (const std::string& s) { put (s.data (), s.size ()); }
+	void put (char c) {
+		buffer += c;
+		if (buffer.size () >= CAPACITY) flush ();
+	}
+	void number (Real v) {
+		char b[32];
+		put (b, format_number (b, v));
+	}
+	std::ostream& out;
+	std::string buffer;
+};
+void print (AtomPtr e, Writer& out, bool write = false) {
+	std::vector<std::pair<const Atom*, unsigned>> open; // lists and lambdas being printed, next child
+	const Atom* a = e.get ();
+	while (true) {
+		if (a != nullptr) { // to have () printed for nil
+			switch (a->type) {
+			case LIST:
+				out.put ('(');
+				open.push_back ({a, 0});
+			break;
+			case SYMBOL:
+				out.put (a->lexeme);
+			break;
+			case STRING:
+				if (write) out.put ('\"');
+				out.put (a->lexeme);
+				if (write) out.put ('\"');
+			break;
+			case NUMBER:
+				out.number (a->value);
+			break;
+			case LAMBDA: case MACRO: // vars and body
+				out.put (a->type == LAMBDA ? "(lambda " : "(macro ");
+				open.push_back ({a, 0});
+	 		break;
+			case OP:
+				if (write) out.put (a->lexeme);
+				else {
+					char b[64];
+					out.put (b, snprintf (b, sizeof (b), "<op @ %p>", (const void*) &a->op));
+				}
+			break;
+			case OBJECT:
+				out.flush ();
+				a->obj->print (out.out);
+			break;
 			}
-			out << ")";
-		break;
-		case SYMBOL:
-			out << e->lexeme;
-		break;
-		case STRING:
-			if (write) out << "\"" << e->lexeme << "\"";
-			else out << e->lexeme;
-		break;
-		case NUMBER:
-			out << std::setprecision (15) << e->value;
-		break;
-		case LAMBDA: case MACRO:
-			if (e->type == LAMBDA) out << "(lambda ";
-			else out << "(macro ";
-			print (e->tail.at (0), out, write) << " "; // vars
-			print (e->tail.at (1), out, write) << ")"; // body
- 		break;
-		case OP:
-			if (write) out << e->lexeme;
-			else out << "<op @ " << (std::hex) << &e->op << ">";
-		break;
 		}
+		a = nullptr;
+		while (open.size ()) { // next child of the innermost open list, or close it
+			auto& top = open.back ();
+			unsigned n = top.first->type == LIST ? top.first->tail.size () : 2;
+			if (top.second < n) {
+				if (top.second) out.put (' ');
+				a = top.first->tail.at (top.second++).get ();
+				break;
+			}
+			out.put (')');
+			open.pop_back ();
+		}
+		if (open.empty () && a == nullptr) return;
 	}
+}
+std::ostream& print (AtomPtr e, std::ostream& out, bool write = false) {
+	Writer w (out);
+	print (e, w, write);
 	return out;
 }
 void error (const std::string& msg, AtomPtr n) {
@@ -128,30 +237,51 @@ void error (const std::string& msg, AtomPtr n) {
 		err << " -> ";
 		print (n, err);
 	}
-    if (eval_stack.size () > 1) {
-        err << "\n\n[--- stack trace ---]" << std::endl;
-		int ctx = eval_stack.size (); 
-        for (auto it = eval_stack.rbegin(); it != eval_stack.rend(); ++it) {
-        	err << ctx << "> "; print(*it, err) << std::endl;
+	if (eval_stack.size () > 1) { // innermost evaluations first, long traces are cut
+		const int shown = 24;
+		err << "\n\n[--- stack trace ---]" << std::endl;
+		int ctx = eval_stack.size ();
+		for (auto it = eval_stack.rbegin (); it != eval_stack.rend (); ++it) {
+			if ((int) eval_stack.size () - ctx == shown && ctx > 1) {
+				err << "... " << ctx - 1 << " more\n\n";
+				ctx = 1;
+				it = eval_stack.rend () - 1;
+			}
+			err << ctx << "> "; print (*it, err) << std::endl;
 			if (ctx > 1) err << std::endl;
 			--ctx;
-        }
+		}
 		err << "[--- end of stack trace ---]\n";
-    }	
+	}
 	throw std::runtime_error (err.str ());
 }
 AtomPtr args_check (AtomPtr node, unsigned args) {
-	std::stringstream err;
-	err << "insufficient number of arguments (required " << args << ", got " << node->tail.size () << ")";
-	if (node->tail.size () < args) error (err.str (), node);
+	if (node->tail.size () < args) {
+		std::stringstream err;
+		err << "insufficient number of arguments (required " << args << ", got " << node->tail.size () << ")";
+		error (err.str (), node);
+	}
 	return node;
 }
 AtomPtr type_check (AtomPtr node, AtomType t) {
-	std::stringstream err;
-	err << "invalid type (required " << ATOM_NAMES[t] << ", got " << ATOM_NAMES[node->type] << ")";
-	if (node->type != t) error (err.str (), node);
+	if (node->type != t) {
+		std::stringstream err;
+		err << "invalid type (required " << ATOM_NAMES[t] << ", got " << ATOM_NAMES[node->type] << ")";
+		error (err.str (), node);
+	}
 	return node;
 }
+template <typename T>
+T* object_check (AtomPtr node) {
+	T* o = (node->type == OBJECT ? dynamic_cast<T*> (node->obj.get ()) : nullptr);
+	if (o == nullptr) {
+		std::stringstream err;
+		err << "invalid type (required " << T::NAME << ", got " 
+			<< (node->type == OBJECT ? node->obj->name () : ATOM_NAMES[node->type]) << ")";
+		error (err.str (), node);
+	}
+	return o;
+}
 
 // lexing, parsing, evaluation
 std::string next (std::istream &in, unsigned& linenum) {
@@ -241,17 +371,15 @@ AtomPtr read (std::istream& in, unsigned& linenum) {
 		return make_atom (token);
 	}
 }
-bool atom_eq (AtomPtr a, AtomPtr b) {
-	if (is_nil (a) && !is_nil (b)) return false;
-	if (!is_nil (a) && is_nil (b)) return false;
-	if (is_nil (a) && is_nil (b)) return true;
+bool atom_eq (const Atom* a, const Atom* b, std::vector<std::pair<const Atom*, const Atom*>>& nested) {
+	bool nil_a = a == nullptr || (a->type == LIST && a->tail.empty ());
+	bool nil_b = b == nullptr || (b->type == LIST && b->tail.empty ());
+	if (nil_a || nil_b) return nil_a == nil_b;
 	if (a->type != b->type) return false;
 	switch (a->type) {
-		case LIST:
+		case LIST: // elements are compared by the caller
 			if (a->tail.size () != b->tail.size ()) return false;
-			for (unsigned i = 0; i < a->tail.size (); ++i) {
-				if (! atom_eq (a->tail.at (i), b->tail.at (i))) return false;
-			}
+			for (unsigned i = 0; i < a->tail.size (); ++i) nested.push_back ({a->tail[i].get (), b->tail[i].get ()});
 			return true;
 		break;
 		case SYMBOL: case STRING:
@@ -270,39 +398,75 @@ bool atom_eq (AtomPtr a, AtomPtr b) {
 		case OP:
 			return a->op == b->op;
 		break;
+		case OBJECT:
+			return a->obj == b->obj;
+		break;
 	}
 	return false; // dummy
 }
-AtomPtr assoc (AtomPtr node, AtomPtr env) {
-	for (unsigned i = 1; i < env->tail.size (); ++i) {
-		AtomPtr vv = env->tail.at (i);
-		if (atom_eq (node, vv->tail.at (0))) return vv->tail.at(1);
+bool atom_eq (const AtomPtr& a, const AtomPtr& b) {
+	std::vector<std::pair<const Atom*, const Atom*>> nested; // allocates only for lists
+	if (!atom_eq (a.get (), b.get (), nested)) return false;
+	while (nested.size ()) {
+		auto p = nested.back ();
+		nested.pop_back ();
+		if (!atom_eq (p.first, p.second, nested)) return false;
+	}
+	return true;
+}
+AtomPtr assoc (const AtomPtr& node, const AtomPtr& env) {
+	for (const Atom* e = env.get (); ; e = e->tail.at (0).get ()) {
+		for (unsigned i = 1; i < e->tail.size (); ++i) {
+			const AtomPtr& vv = e->tail.at (i);
+			if (atom_eq (node, vv->tail.at (0))) return vv->tail.at(1);
+		}
+		if (is_nil (e->tail.at (0))) break;
 	}
-	if (!is_nil (env->tail.at (0))) return assoc (node, env->tail.at (0));
 	error ("unbound identifier", node);
 	return make_atom (); // dummy
 }
 AtomPtr extend (AtomPtr node, AtomPtr val, AtomPtr env, bool recurse = false) {
-	for (unsigned i = 1; i < env->tail.size (); ++i) {
-		AtomPtr vv = env->tail.at (i);
-		if (atom_eq (node, vv->tail.at (0))) {
-			vv->tail.at(1) = val;
-			return val;
+	for (Atom* e = env.get (); ; e = e->tail.at (0).get ()) {
+		for (unsigned i = 1; i < e->tail.size (); ++i) {
+			const AtomPtr& vv = e->tail.at (i);
+			if (atom_eq (node, vv->tail.at (0))) {
+				vv->tail.at(1) = val;
+				return val;
+			}
 		}
+		if (!recurse) break;
+		if (is_nil (e->tail.at (0))) error ("unbound identifier", node); // set
 	}
-	if (recurse) { // set
-		if (!is_nil (env->tail.at (0))) return extend (node, val, env->tail.at (0), recurse);
-		error ("unbound identifier", node);
-	} else {
-		AtomPtr vv = make_atom();
-		vv->tail.push_back (node);
-		vv->tail.push_back (val);
-		env->tail.push_back (vv);
-		return val;
-	}
-	
-	return make_atom(); // dummy
+	AtomPtr vv = make_atom();
+	vv->tail.push_back (node);
+	vv->tail.push_back (val);
+	env->tail.push_back (vv);
+	return val;
+}
+struct Promise : public Object { // (delay expr): evaluated once, on the first force
+	static constexpr const char* NAME = "promise";
+	const char* name () const { return NAME; }
+	Promise (AtomPtr e, AtomPtr en) : expr (e), env (en) {}
+	AtomPtr expr, env, value;
+};
+// environments are shared with the threads running futures: once the first
+// future has been spawned, every lookup takes env_lock shared and every
+// definition or set! takes it exclusive. The flag never drops back, so no
+// thread can be inside an unlocked bind while a future runs; until then the
+// only evaluator of an environment tree is the thread that owns it
+inline std::shared_mutex env_lock;
+inline std::atomic<bool> futures_started {false};
+AtomPtr lookup (AtomPtr node, AtomPtr env) {
+	std::shared_lock<std::shared_mutex> guard (env_lock, std::defer_lock);
+	if (futures_started) guard.lock ();
+	return assoc (node, env);
 }
+AtomPtr bind (AtomPtr node, AtomPtr val, AtomPtr env, bool set = false) {
+	std::unique_lock<std::shared_mutex> guard (env_lock, std::defer_lock);
+	if (futures_started) guard.lock ();
+	return extend (node, val, env, set);
+}
+AtomPtr spawn_future (AtomPtr expr, AtomPtr env);
 AtomPtr fn_quote (AtomPtr, AtomPtr) { return nullptr; } // dummy
 AtomPtr fn_def (AtomPtr, AtomPtr) { return nullptr; } // dummy
 AtomPtr fn_set (AtomPtr, AtomPtr) { return nullptr; } // dummy
@@ -313,123 +477,289 @@ AtomPtr fn_while (AtomPtr, AtomPtr) { return nullptr; } // dummy
 AtomPtr fn_begin (AtomPtr, AtomPtr) { return nullptr; } // dummy
 AtomPtr fn_apply (AtomPtr, AtomPtr) { return nullptr; } // dummy
 AtomPtr fn_eval (AtomPtr, AtomPtr) { return nullptr; } // dummy
+AtomPtr fn_delay (AtomPtr, AtomPtr) { return nullptr; } // dummy
+AtomPtr fn_provide (AtomPtr, AtomPtr) { return nullptr; } // dummy
+AtomPtr fn_future (AtomPtr, AtomPtr) { return nullptr; } // dummy
+// eval runs on an explicit continuation stack: a compound form pushes a frame
+// recording what to do with the value of its next subexpression, so non-tail
+// recursion grows the heap (up to stack_limit frames) instead of the C++
+// stack, while tail calls replace the current form without pushing anything
+enum FrameKind {K_HEAD, K_ARGS, K_DEFINE, K_IF, K_WHILE_TEST, K_WHILE_BODY, K_BEGIN, K_BODY,
+	K_MACRO_EXPAND, K_MACRO_RUN, K_MACRO_LAST, K_COMPLETE};
+struct Frame {
+	FrameKind kind;
+	AtomPtr node, env, func, data; // data: evaluated arguments, loop result or body
+	unsigned i;
+};
+inline thread_local std::vector<Frame> frames;
+void push_frame (FrameKind kind, const AtomPtr& node, const AtomPtr& env,
+	const AtomPtr& func = nullptr, const AtomPtr& data = nullptr, unsigned i = 0) {
+	if (frames.size () >= stack_limit) error ("stack overflow (see stack-limit)", node);
+	frames.push_back ({kind, node, env, func, data, i});
+	eval_stack.push_back (node); // every pending frame is traced, long traces are cut in error ()
+}
+void pop_frame () {
+	eval_stack.pop_back ();
+	frames.pop_back ();
+}
+struct EvalGuard { // drops the frames an error leaves behind
+	size_t base, trace;
+	EvalGuard (const AtomPtr& node) : base (frames.size ()), trace (eval_stack.size ()) {
+		eval_stack.push_back (node);
+	}
+	~EvalGuard () {
+		frames.erase (frames.begin () + base, frames.end ());
+		eval_stack.resize (trace);
+	}
+};
 AtomPtr eval (AtomPtr node, AtomPtr env) {
-	StackGuard guard(node); 
+	EvalGuard guard (node);
+	enum {EVAL, APPLY, RETURN} mode = EVAL;
+	AtomPtr val, func, args;
 	while (true) {
-		if (is_nil (node)) return make_atom ();
-		if (node->type == SYMBOL && node->lexeme.size ()) return assoc (node, env);
-		if (node->type != LIST) return node;
-
-		AtomPtr func = eval (node->tail.at (0), env);
-		if (func->op == &fn_quote) {
-			args_check (node, 2);
-			return node->tail.at (1);
-		}
-		if (func->op == &fn_def) {
-			args_check (node, 3);
-			return extend (type_check (node->tail.at (1), SYMBOL), eval (node->tail.at (2), env), env);
-		}
-		if (func->op == &fn_set) {
-			args_check (node, 3);
-			return extend (type_check (node->tail.at (1), SYMBOL), eval (node->tail.at (2), env), env, true);
-		}
-		if (func->op == &fn_lambda || func->op == &fn_macro) {
-			args_check (node, 3);
-			AtomPtr ll = make_atom();
-			ll->tail.push_back (type_check (node->tail.at (1), LIST)); // vars
-			AtomPtr body = make_atom ();
-			for (unsigned i = 2; i < node->tail.size (); ++i) {
-				body->tail.push_back (node->tail.at (i));
-			}
-			ll->tail.push_back (body); // body
-			ll->tail.push_back (env); // env (lexical scope)
-			AtomPtr f = make_atom(ll); // lambda
-			if (func->op == &fn_macro) f->type = MACRO;
-			return f;
-		}
-		if (func->op == &fn_if) {
-			args_check (node, 3);
-			if (type_check (eval (node->tail.at (1), env), NUMBER)->value) {
-				node = node->tail.at (2);
-				continue; 
-			} else {
-				if (node->tail.size () == 4) {
-					node = node->tail.at (3);
-					continue; 
-				} else return make_atom ();
+		if (mode == EVAL) { // node in env
+			if (deadline_set && ++eval_ticks % 1024 == 0 && std::chrono::steady_clock::now () > deadline) {
+				error ("evaluation timed out", node);
 			}
-		}
-		if (func->op == &fn_while) {
-			args_check (node, 3);
-			AtomPtr r = make_atom ();
-			while (type_check (eval (node->tail.at (1), env), NUMBER)->value) {
-				r = eval (node->tail.at (2), env);
+			mode = RETURN;
+			if (is_nil (node)) val = make_atom ();
+			else if (node->type == SYMBOL && node->lexeme.size ()) val = lookup (node, env);
+			else if (node->type != LIST) val = node;
+			else {
+				push_frame (K_HEAD, node, env);
+				node = node->tail.at (0);
+				mode = EVAL;
 			}
-			return r;
-		}	
-		if (func->op == &fn_begin) {
-			args_check (node, 2);
-			for (unsigned i = 0; i < node->tail.size () - 1; ++i) {
-				eval (node->tail.at (i), env);
-			} 
-			node = node->tail.at (node->tail.size () - 1);
-			continue; 
-		}
-		AtomPtr args = make_atom();
-		for (unsigned i = 1; i < node->tail.size (); ++i) {
-			args->tail.push_back ((func->type == MACRO ? node->tail.at (i) : eval (node->tail.at (i), env)));
+			continue;
 		}
-		if (func->type == LAMBDA || func->type == MACRO) {
-			AtomPtr vars = func->tail.at (0);
-			AtomPtr body = func->tail.at (1);
-			AtomPtr nenv = make_atom ();
-			nenv->tail.push_back (func->tail.at (2)); // new environment with static binding
+		if (mode == APPLY) { // func to args, called from node in env
+			if (func->type == LAMBDA || func->type == MACRO) {
+				AtomPtr vars = func->tail.at (0);
+				AtomPtr body = func->tail.at (1);
+				AtomPtr nenv = make_atom ();
+				nenv->tail.push_back (func->tail.at (2)); // new environment with static binding
 
-			if (vars->tail.size () < args->tail.size ()) error ("too many arguments in lambda/macro", node);
-			unsigned minargs = (vars->tail.size () > args->tail.size () ? args->tail.size () : vars->tail.size ());
-			for (unsigned i = 0; i < minargs; ++i) {
-				extend (vars->tail.at (i), args->tail.at (i), nenv);
-			}
-
-			if (vars->tail.size () > args->tail.size ()) {		
-				AtomPtr vars_cut = make_atom ();
+				if (vars->tail.size () < args->tail.size ()) error ("too many arguments in lambda/macro", node);
+				unsigned minargs = (vars->tail.size () > args->tail.size () ? args->tail.size () : vars->tail.size ());
 				for (unsigned i = 0; i < minargs; ++i) {
-					vars_cut->tail.push_back (vars->tail.at (i));
-				}	
-				AtomPtr new_lambda = make_atom (); 
-				new_lambda->tail.push_back (vars_cut);
-				new_lambda->tail.push_back (body);
-				new_lambda->tail.push_back (nenv);
-				AtomPtr f = make_atom (new_lambda); // return lambda/macro with bounded vars
-				if (func->type == MACRO) f->type = MACRO;
-				return f;
+					extend (vars->tail.at (i), args->tail.at (i), nenv);
+				}
+
+				if (vars->tail.size () > args->tail.size ()) {		
+					AtomPtr vars_cut = make_atom ();
+					for (unsigned i = 0; i < minargs; ++i) {
+						vars_cut->tail.push_back (vars->tail.at (i));
+					}	
+					AtomPtr new_lambda = make_atom (); 
+					new_lambda->tail.push_back (vars_cut);
+					new_lambda->tail.push_back (body);
+					new_lambda->tail.push_back (nenv);
+					val = make_atom (new_lambda); // return lambda/macro with bounded vars
+					if (func->type == MACRO) val->type = MACRO;
+					mode = RETURN;
+					continue;
+				}
+				if (func->type == MACRO) { // each body form is expanded, then evaluated
+					push_frame (body->tail.size () > 1 ? K_MACRO_EXPAND : K_MACRO_LAST, node, nenv, func, body);
+				} else if (body->tail.size () > 1) {
+					push_frame (K_BODY, node, nenv, func, body);
+				}
+				node = body->tail.at (0);
+				env = nenv;
+				mode = EVAL;
+			} else if (func->type == OBJECT && func->obj->callable ()) {
+				AtomPtr next;
+				eval_stack.push_back (node);
+				val = func->obj->apply (args, node, env, next);
+				eval_stack.pop_back ();
+				if (val) mode = RETURN;
+				else {
+					push_frame (K_COMPLETE, node, env, func, args);
+					func = next;
+				}
+			} else if (func->type == OP) {
+				args_check (args, func->minargs);
+				if (func->op == &fn_eval) {
+					node = args->tail.at (0);
+					mode = EVAL;
+				} else if (func->op == &fn_apply) {
+					AtomPtr l = make_atom ();
+					l->tail.push_back (args->tail.at (0));
+					AtomPtr rest = type_check (args->tail.at (1), LIST);
+					l->tail.insert (l->tail.end (), rest->tail.begin (), rest->tail.end ());
+					node = l;
+					mode = EVAL;
+				} else {
+					eval_stack.push_back (node);
+					val = func->op (args, env);
+					eval_stack.pop_back ();
+					mode = RETURN;
+				}
+			} else error ("function expected", node);
+			continue;
+		}
+		// mode == RETURN: val goes to the innermost frame of this evaluation
+		if (frames.size () == guard.base) return val;
+		Frame& f = frames.back ();
+		switch (f.kind) {
+		case K_HEAD: {
+			node = f.node;
+			env = f.env;
+			pop_frame ();
+			func = val;
+			Functor op = func->type == OP ? func->op : nullptr;
+			if (op == &fn_quote) {
+				args_check (node, 2);
+				val = node->tail.at (1);
+			} else if (op == &fn_def || op == &fn_set) {
+				args_check (node, 3);
+				type_check (node->tail.at (1), SYMBOL);
+				push_frame (K_DEFINE, node, env, func);
+				node = node->tail.at (2);
+				mode = EVAL;
+			} else if (op == &fn_lambda || op == &fn_macro) {
+				args_check (node, 3);
+				AtomPtr ll = make_atom();
+				ll->tail.push_back (type_check (node->tail.at (1), LIST)); // vars
+				AtomPtr body = make_atom ();
+				for (unsigned i = 2; i < node->tail.size (); ++i) {
+					body->tail.push_back (node->tail.at (i));
+				}
+				ll->tail.push_back (body); // body
+				ll->tail.push_back (env); // env (lexical scope)
+				val = make_atom(ll); // lambda
+				if (op == &fn_macro) val->type = MACRO;
+			} else if (op == &fn_provide) {
+				val = make_atom (); // only meaningful to require
+			} else if (op == &fn_future) {
+				args_check (node, 2);
+				val = spawn_future (node->tail.at (1), env);
+			} else if (op == &fn_delay) {
+				args_check (node, 2);
+				val = make_atom (std::make_shared<Promise> (node->tail.at (1), env));
+			} else if (op == &fn_if) {
+				args_check (node, 3);
+				push_frame (K_IF, node, env);
+				node = node->tail.at (1);
+				mode = EVAL;
+			} else if (op == &fn_while) {
+				args_check (node, 3);
+				push_frame (K_WHILE_TEST, node, env, nullptr, make_atom ());
+				node = node->tail.at (1);
+				mode = EVAL;
+			} else if (op == &fn_begin) {
+				args_check (node, 2);
+				if (node->tail.size () > 2) push_frame (K_BEGIN, node, env, nullptr, nullptr, 1);
+				node = node->tail.at (1);
+				mode = EVAL;
+			} else if (func->type == MACRO || node->tail.size () == 1) { // arguments as they are
+				args = make_atom ();
+				args->tail.assign (node->tail.begin () + 1, node->tail.end ());
+				mode = APPLY;
+			} else {
+				push_frame (K_ARGS, node, env, func, make_atom (), 1);
+				node = node->tail.at (1);
+				mode = EVAL;
 			}
-			env = nenv;
-			for (unsigned i = 0; i < body->tail.size () - 1; ++i) {
-				eval ((func->type == MACRO ? eval (body->tail.at (i), nenv) : body->tail.at (i)), nenv);
+		} break;
+		case K_ARGS:
+			f.data->tail.push_back (val);
+			env = f.env;
+			if (++f.i < f.node->tail.size ()) {
+				node = f.node->tail.at (f.i);
+				mode = EVAL;
+			} else {
+				node = f.node;
+				func = f.func;
+				args = f.data;
+				pop_frame ();
+				mode = APPLY;
 			}
-			node = (func->type == MACRO ? eval (body->tail.at (body->tail.size () - 1), nenv) 
-				: body->tail.at (body->tail.size () - 1));		
-			continue; 
+		break;
+		case K_DEFINE: {
+			AtomPtr name = f.node->tail.at (1);
+			bool set = f.func->op == &fn_set;
+			env = f.env;
+			pop_frame ();
+			val = bind (name, val, env, set);
+		} break;
+		case K_IF: {
+			bool test = type_check (val, NUMBER)->value;
+			node = f.node;
+			env = f.env;
+			pop_frame ();
+			if (test) {
+				node = node->tail.at (2);
+				mode = EVAL;
+			} else if (node->tail.size () == 4) {
+				node = node->tail.at (3);
+				mode = EVAL;
+			} else val = make_atom ();
+		} break;
+		case K_WHILE_TEST:
+			if (type_check (val, NUMBER)->value) {
+				f.kind = K_WHILE_BODY;
+				node = f.node->tail.at (2);
+				env = f.env;
+				mode = EVAL;
+			} else {
+				val = f.data; // value of the last iteration
+				pop_frame ();
+			}
+		break;
+		case K_WHILE_BODY:
+			f.data = val;
+			f.kind = K_WHILE_TEST;
+			node = f.node->tail.at (1);
+			env = f.env;
+			mode = EVAL;
+		break;
+		case K_BEGIN: case K_BODY: { // the last form is evaluated in tail position
+			const AtomPtr& forms = f.kind == K_BEGIN ? f.node : f.data;
+			node = forms->tail.at (++f.i);
+			env = f.env;
+			if (f.i == forms->tail.size () - 1) pop_frame ();
+			mode = EVAL;
+		} break;
+		case K_MACRO_EXPAND:
+			f.kind = K_MACRO_RUN;
+			node = val;
+			env = f.env;
+			mode = EVAL;
+		break;
+		case K_MACRO_RUN:
+			node = f.data->tail.at (++f.i);
+			env = f.env;
+			if (f.i == f.data->tail.size () - 1) f.kind = K_MACRO_LAST;
+			else f.kind = K_MACRO_EXPAND;
+			mode = EVAL;
+		break;
+		case K_MACRO_LAST:
+			node = val;
+			env = f.env;
+			pop_frame ();
+			mode = EVAL;
+		break;
+		case K_COMPLETE:
+			f.func->obj->complete (f.data, val);
+			pop_frame ();
+		break;
 		}
-		if (func->type == OP) {
-			args_check (args, func->minargs);
-			if (func->op == &fn_eval) {
-				node = args->tail.at (0);
-				continue; 
-			}	
-			if (func->op == &fn_apply) {
-				AtomPtr l = type_check (args->tail.at (1), LIST);
-				l->tail.insert (l->tail.begin(), args->tail.at(0));
-
-				node = l;
-				continue; 
-			}			
-			return func->op (args, env);
-		}	
-		error ("function expected", node);
 	}
 }
+// applies a function value to already evaluated arguments (for native code)
+AtomPtr call (AtomPtr f, const std::vector<AtomPtr>& args, AtomPtr env) {
+	thread_local AtomPtr quote = make_atom (&fn_quote);
+	AtomPtr node = make_atom ();
+	node->tail.push_back (f);
+	for (auto& a : args) {
+		AtomPtr q = make_atom ();
+		q->tail.push_back (quote);
+		q->tail.push_back (a);
+		node->tail.push_back (q);
+	}
+	return eval (node, env);
+}
 
 // functors
 AtomPtr fn_env (AtomPtr node, AtomPtr env) {
@@ -461,23 +791,62 @@ AtomPtr fn_cdr (AtomPtr node, AtomPtr env) {
 	}
 	return cdr;
 }
+// vectors: lists are already contiguous, these expose indexing and in-place update
+size_t vector_index (AtomPtr v, AtomPtr i, AtomPtr node, size_t limit) {
+	Real idx = type_check (i, NUMBER)->value;
+	if (idx < 0 || idx >= limit || idx != std::floor (idx)) error ("index out of range", node);
+	return (size_t) idx;
+}
+AtomPtr fn_make_vector (AtomPtr node, AtomPtr env) {
+	Real n = type_check (node->tail.at (0), NUMBER)->value;
+	if (n < 0) error ("invalid vector size", node);
+	AtomPtr v = make_atom ();
+	v->tail.assign ((size_t) n, node->tail.size () > 1 ? node->tail.at (1) : make_atom (0.0));
+	return v;
+}
+AtomPtr fn_vector_ref (AtomPtr node, AtomPtr env) {
+	AtomPtr v = type_check (node->tail.at (0), LIST);
+	return v->tail[vector_index (v, node->tail.at (1), node, v->tail.size ())];
+}
+AtomPtr fn_vector_set (AtomPtr node, AtomPtr env) {
+	AtomPtr v = type_check (node->tail.at (0), LIST);
+	return v->tail[vector_index (v, node->tail.at (1), node, v->tail.size ())] = node->tail.at (2);
+}
+AtomPtr fn_vector_length (AtomPtr node, AtomPtr env) {
+	return make_atom ((Real) type_check (node->tail.at (0), LIST)->tail.size ());
+}
+// (subvector v start [end]) copies [start, end)
+AtomPtr fn_subvector (AtomPtr node, AtomPtr env) {
+	AtomPtr v = type_check (node->tail.at (0), LIST);
+	size_t start = vector_index (v, node->tail.at (1), node, v->tail.size () + 1);
+	size_t end = node->tail.size () > 2 ? vector_index (v, node->tail.at (2), node, v->tail.size () + 1) : v->tail.size ();
+	if (end < start) error ("index out of range", node);
+	AtomPtr r = make_atom ();
+	r->tail.assign (v->tail.begin () + start, v->tail.begin () + end);
+	return r;
+}
 AtomPtr fn_eq (AtomPtr node, AtomPtr env) {
 	return make_atom ((Real) atom_eq (node->tail.at (0), node->tail.at (1)));
 }
 AtomPtr fn_type (AtomPtr node, AtomPtr env) {
+	if (node->tail.at (0)->type == OBJECT) return make_atom (node->tail.at (0)->obj->name ());
 	return make_atom (ATOM_NAMES[node->tail.at (0)->type]);
 }
 template <bool WRITE>
 AtomPtr fn_print (AtomPtr node, AtomPtr env) {
-	std::ostream* out = &std::cout;
+	std::ofstream file;
+	std::ostream* out = output;
 	if (WRITE) {
-		out = new std::ofstream (type_check (node->tail.at (0), STRING)->lexeme);
-		if (!out->good ()) error ("cannot create output file", node);
+		file.open (type_check (node->tail.at (0), STRING)->lexeme);
+		if (!file.good ()) error ("cannot create output file", node);
+		out = &file;
 	}
+	Writer w (*out);
 	for (unsigned int i = WRITE; i < node->tail.size (); ++i) {
-		print (node->tail.at (i), *out, WRITE);
+		print (node->tail.at (i), w, WRITE);
 	}
-	if (WRITE) ((std::ofstream*) out)->close (); // downcast
+	w.flush ();
+	if (!out->good ()) error ("cannot write output", node);
 	return make_atom ("");
 }
 AtomPtr fn_read (AtomPtr node, AtomPtr env) {
@@ -513,6 +882,228 @@ AtomPtr fn_load (AtomPtr node, AtomPtr env) {
 	if (!in.good ()) error ("cannot open input file", node);
 	return load (node->tail.at (0)->lexeme, in, env);
 }
+// modules: (require "file.scm" [prefix]) evaluates a file once per interpreter
+// in its own environment (a child of the global one) and binds its exports,
+// named by (provide name ...) or else all of its top-level definitions, in the
+// requiring environment, as prefix:name when a prefix is given. The parsed
+// forms are cached beside the source in <file>.snipc, which is reused while the
+// source mtime and size match, or else while the content hash still matches
+struct Module : public Object {
+	static constexpr const char* NAME = "module";
+	const char* name () const { return NAME; }
+	AtomPtr env;
+	std::vector<AtomPtr> exports;
+	bool loading = true;
+};
+struct ModuleTable : public Object {
+	static constexpr const char* NAME = "modules";
+	const char* name () const { return NAME; }
+	std::unordered_map<std::string, std::shared_ptr<Module>> modules;
+};
+inline thread_local std::vector<std::string> module_dirs; // directories of the modules being loaded
+struct ParsedFile {
+	std::vector<AtomPtr> forms;
+	std::vector<unsigned> lines; // line of each form, for error messages
+};
+const uint32_t SNIPC_VERSION = 1;
+uint64_t content_hash (const std::string& data) { // FNV-1a
+	uint64_t h = 1469598103934665603ULL;
+	for (unsigned char c : data) h = (h ^ c) * 1099511628211ULL;
+	return h;
+}
+void write_cached_atom (std::ostream& out, AtomPtr a) { // native byte order, the cache is local
+	uint8_t tag = a->type;
+	out.put (tag);
+	if (a->type == LIST) {
+		uint32_t n = a->tail.size ();
+		out.write ((const char*) &n, 4);
+		for (auto& e : a->tail) write_cached_atom (out, e);
+	} else if (a->type == NUMBER) {
+		out.write ((const char*) &a->value, sizeof (Real));
+	} else {
+		uint32_t n = a->lexeme.size ();
+		out.write ((const char*) &n, 4);
+		out.write (a->lexeme.data (), n);
+	}
+}
+AtomPtr read_cached_atom (std::istream& in) {
+	int tag = in.get ();
+	uint32_t n = 0;
+	AtomPtr a = make_atom ();
+	switch (tag) {
+		case LIST:
+			in.read ((char*) &n, 4);
+			a->tail.reserve (n);
+			for (uint32_t i = 0; i < n && in; ++i) a->tail.push_back (read_cached_atom (in));
+		break;
+		case NUMBER:
+			a->type = NUMBER;
+			in.read ((char*) &a->value, sizeof (Real));
+		break;
+		case SYMBOL: case STRING:
+			a->type = (AtomType) tag;
+			in.read ((char*) &n, 4);
+			if (!in || n > (1u << 30)) throw std::runtime_error ("corrupted cache");
+			a->lexeme.resize (n);
+			in.read (&a->lexeme[0], n);
+		break;
+		default: throw std::runtime_error ("corrupted cache");
+	}
+	if (!in) throw std::runtime_error ("corrupted cache");
+	return a;
+}
+struct CacheHeader {
+	char magic[8];
+	uint32_t version;
+	int64_t mtime;
+	uint64_t size, hash;
+	uint32_t count;
+};
+void write_cache (const std::string& path, const CacheHeader& h, const ParsedFile& p) {
+	std::string tmp = path + ".tmp" + std::to_string (std::hash<std::thread::id> () (std::this_thread::get_id ()));
+	{
+		std::ofstream out (tmp, std::ios::binary);
+		if (!out) return; // read-only directory: just don't cache
+		out.write ((const char*) &h, sizeof (h));
+		for (size_t i = 0; i < p.forms.size (); ++i) {
+			out.write ((const char*) &p.lines[i], 4);
+			write_cached_atom (out, p.forms[i]);
+		}
+		if (!out) return;
+	}
+	std::error_code ec;
+	std::filesystem::rename (tmp, path, ec);
+	if (ec) std::filesystem::remove (tmp, ec);
+}
+ParsedFile parse_file (const std::string& fname, AtomPtr node) {
+	namespace fs = std::filesystem;
+	std::error_code ec;
+	auto mtime = fs::last_write_time (fname, ec);
+	uint64_t size = fs::file_size (fname, ec);
+	if (ec) error ("cannot open input file", node);
+	std::string cache = fname + ".snipc"; // appended, so m/x and m/x.scm stay apart
+	CacheHeader h = {{'S', 'N', 'I', 'P', 'C', 'A', 'C', 'H'}, SNIPC_VERSION,
+		(int64_t) mtime.time_since_epoch ().count (), size, 0, 0};
+	ParsedFile p;
+	std::ifstream cached (cache, std::ios::binary);
+	CacheHeader old;
+	bool valid = cached.read ((char*) &old, sizeof (old)) && !memcmp (old.magic, h.magic, 8)
+		&& old.version == h.version && old.size == h.size;
+	std::string text;
+	if (valid && old.mtime != h.mtime) { // touched: still valid if the content is the same
+		std::ifstream in (fname, std::ios::binary);
+		text.assign (std::istreambuf_iterator<char> (in), std::istreambuf_iterator<char> ());
+		valid = content_hash (text) == old.hash;
+	}
+	if (valid) {
+		try {
+			for (uint32_t i = 0; i < old.count; ++i) {
+				uint32_t line = 0;
+				cached.read ((char*) &line, 4);
+				p.lines.push_back (line);
+				p.forms.push_back (read_cached_atom (cached));
+			}
+			if (old.mtime != h.mtime) {
+				h.hash = old.hash;
+				h.count = old.count;
+				write_cache (cache, h, p); // refresh the stored mtime
+			}
+			return p;
+		} catch (std::exception&) {
+			p = ParsedFile (); // fall back to parsing the source
+		}
+	}
+	if (text.empty ()) {
+		std::ifstream in (fname, std::ios::binary);
+		if (!in.good ()) error ("cannot open input file", node);
+		text.assign (std::istreambuf_iterator<char> (in), std::istreambuf_iterator<char> ());
+	}
+	std::istringstream in (text);
+	unsigned linenum = 0;
+	while (!in.eof ()) {
+		AtomPtr l = read (in, linenum);
+		if (!in.eof () || !is_nil (l)) {
+			p.forms.push_back (l);
+			p.lines.push_back (linenum);
+		}
+	}
+	h.hash = content_hash (text);
+	h.count = p.forms.size ();
+	write_cache (cache, h, p);
+	return p;
+}
+AtomPtr global_env (AtomPtr env) {
+	while (!is_nil (env->tail.at (0))) env = env->tail.at (0);
+	return env;
+}
+std::string resolve_module (const std::string& name) {
+	namespace fs = std::filesystem;
+	std::error_code ec;
+	fs::path p (name);
+	if (p.is_relative () && module_dirs.size ()) { // relative to the requiring module first
+		fs::path q = fs::path (module_dirs.back ()) / p;
+		if (fs::exists (q, ec)) p = q;
+	}
+	fs::path c = fs::weakly_canonical (p, ec);
+	return ec ? p.string () : c.string ();
+}
+std::shared_ptr<Module> load_module (const std::string& path, AtomPtr env, AtomPtr node) {
+	AtomPtr global = global_env (env);
+	static const AtomPtr key = make_atom (std::string ("*modules*"));
+	ModuleTable* table = nullptr;
+	for (unsigned i = 1; i < global->tail.size () && !table; ++i) {
+		if (atom_eq (global->tail.at (i)->tail.at (0), key)) table = object_check<ModuleTable> (global->tail.at (i)->tail.at (1));
+	}
+	if (!table) table = (ModuleTable*) extend (key, make_atom (std::make_shared<ModuleTable> ()), global)->obj.get ();
+	auto it = table->modules.find (path);
+	if (it != table->modules.end ()) {
+		if (it->second->loading) error ("circular require", node);
+		return it->second;
+	}
+	auto m = std::make_shared<Module> ();
+	m->env = make_atom ();
+	m->env->tail.push_back (global);
+	table->modules[path] = m;
+	try {
+		ParsedFile p = parse_file (path, node);
+		std::vector<AtomPtr> provided;
+		module_dirs.push_back (std::filesystem::path (path).parent_path ().string ());
+		for (size_t i = 0; i < p.forms.size (); ++i) {
+			AtomPtr f = p.forms[i];
+			if (f->type == LIST && f->tail.size () && f->tail[0]->type == SYMBOL && f->tail[0]->lexeme == "provide") {
+				for (unsigned j = 1; j < f->tail.size (); ++j) provided.push_back (type_check (f->tail[j], SYMBOL));
+				continue;
+			}
+			try {
+				eval (f, m->env);
+			} catch (std::exception& e) {
+				module_dirs.pop_back ();
+				throw std::runtime_error ("[" + path + ":" + std::to_string (p.lines[i]) + "] " + e.what ());
+			}
+		}
+		module_dirs.pop_back ();
+		if (provided.empty ()) {
+			for (unsigned i = 1; i < m->env->tail.size (); ++i) m->exports.push_back (m->env->tail.at (i)->tail.at (0));
+		} else m->exports = provided;
+	} catch (...) {
+		table->modules.erase (path); // a later require tries again
+		throw;
+	}
+	m->loading = false;
+	return m;
+}
+AtomPtr fn_require (AtomPtr node, AtomPtr env) {
+	std::string path = resolve_module (type_check (node->tail.at (0), STRING)->lexeme);
+	std::string prefix = node->tail.size () > 1 ? type_check (node->tail.at (1), SYMBOL)->lexeme + ":" : "";
+	std::shared_ptr<Module> m = load_module (path, env, node);
+	AtomPtr names = make_atom ();
+	for (auto& e : m->exports) {
+		AtomPtr name = prefix.size () ? make_atom (prefix + e->lexeme) : e;
+		bind (name, assoc (e, m->env), env);
+		names->tail.push_back (name);
+	}
+	return names;
+}
 #define MAKE_BINOP(op,name, unit) \
 AtomPtr name (AtomPtr node, AtomPtr env) { \
 	Real v = 0; \
@@ -569,41 +1160,149 @@ MAKE_TWOOP (std::fmod, fn_mod);
 MAKE_TWOOP (std::pow, fn_pow);
 MAKE_TWOOP (std::atan2, fn_atan2);
 
-AtomPtr fn_random(AtomPtr node, AtomPtr env) {
-    int n = static_cast<int>(type_check(node->tail.at(0), NUMBER)->value);
-    if (n < 0) {
-        error("random: number of samples must be non-negative", node);
-    }
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_real_distribution<Real> dis(0.0, 1.0);
-    AtomPtr result = make_atom();  // type = LIST
-    for (int i = 0; i < n; ++i) {
-        result->tail.push_back(make_atom(dis(gen)));
-    }
-    return result;
+// xoshiro256** (Blackman/Vigna): small, fast and splittable with jump()
+struct Xoshiro256 {
+	typedef uint64_t result_type;
+	uint64_t s[4];
+	static constexpr uint64_t min () { return 0; }
+	static constexpr uint64_t max () { return UINT64_MAX; }
+	explicit Xoshiro256 (uint64_t seed = 0) {
+		for (auto& v : s) { // splitmix64 expansion of the seed
+			uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			v = z ^ (z >> 31);
+		}
+	}
+	static uint64_t rotl (uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+	uint64_t operator () () {
+		uint64_t r = rotl (s[1] * 5, 7) * 9, t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl (s[3], 45);
+		return r;
+	}
+	Real uniform () { return ((*this) () >> 11) * 0x1.0p-53; } // [0, 1)
+	uint64_t below (uint64_t n) { return (uint64_t) (((unsigned __int128) (*this) () * n) >> 64); } // [0, n)
+	// advances 2^128 steps (long: 2^192), giving non-overlapping substreams
+	void jump (bool long_jump = false) {
+		static const uint64_t J[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+		static const uint64_t LJ[] = {0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL};
+		uint64_t t[4] = {0, 0, 0, 0};
+		for (uint64_t j : long_jump ? LJ : J) {
+			for (int b = 0; b < 64; ++b) {
+				if (j & (1ULL << b)) for (int i = 0; i < 4; ++i) t[i] ^= s[i];
+				(*this) ();
+			}
+		}
+		for (int i = 0; i < 4; ++i) s[i] = t[i];
+	}
+};
+inline std::atomic<uint64_t> rng_seed {std::random_device () ()};
+inline std::atomic<unsigned> rng_epoch {0}, rng_streams {0};
+// per-thread generator: the k-th thread to draw after (seed n) uses the seeded
+// stream long-jumped k times. k follows the order in which threads first call
+// rng (), so draws from futures or server workers running concurrently are not
+// reproducible from the seed; bulk fills inside one primitive (random_fill)
+// hand out their substreams explicitly and are
+Xoshiro256& rng () {
+	thread_local Xoshiro256 gen;
+	thread_local unsigned epoch = ~0u;
+	if (epoch != rng_epoch) {
+		epoch = rng_epoch;
+		gen = Xoshiro256 (rng_seed);
+		for (unsigned k = rng_streams++; k > 0; --k) gen.jump (true);
+	}
+	return gen;
 }
-void replace (std::string &s, std::string from, std::string to) {
-	int idx = 0;
-	size_t next;
+AtomPtr fn_seed (AtomPtr node, AtomPtr env) {
+	rng_seed = (uint64_t) (int64_t) type_check (node->tail.at (0), NUMBER)->value;
+	rng_streams = 0;
+	++rng_epoch;
+	return make_atom ();
+}
+AtomPtr fn_random (AtomPtr node, AtomPtr env) {
+	int n = static_cast<int> (type_check (node->tail.at (0), NUMBER)->value);
+	if (n < 0) {
+		error ("random: number of samples must be non-negative", node);
+	}
+	Xoshiro256& gen = rng ();
+	AtomPtr result = make_atom ();  // type = LIST
+	result->tail.reserve (n);
+	for (int i = 0; i < n; ++i) {
+		result->tail.push_back (make_atom (gen.uniform ()));
+	}
+	return result;
+}
+// Fisher-Yates on a copy of the list
+AtomPtr fn_shuffle (AtomPtr node, AtomPtr env) {
+	AtomPtr result = make_atom ();
+	result->tail = type_check (node->tail.at (0), LIST)->tail;
+	Xoshiro256& gen = rng ();
+	for (size_t i = result->tail.size (); i > 1; --i) std::swap (result->tail[i - 1], result->tail[gen.below (i)]);
+	return result;
+}
+// single pass, so long inputs with many matches stay linear
+std::string replace (const std::string& s, const std::string& from, const std::string& to) {
+	if (from.empty ()) return s;
+	std::string out;
+	out.reserve (s.size ());
+	size_t idx = 0, next;
 	while ((next = s.find (from, idx)) != std::string::npos) {
-		s.replace (next, from.size (), to);
-		idx = next + to.size ();
-	} 
+		out.append (s, idx, next - idx).append (to);
+		idx = next + from.size ();
+	}
+	return out.append (s, idx, std::string::npos);
 }
+// like getline-based splitting: a trailing empty field is dropped
 std::vector<std::string> split (const std::string& in, char separator) {
-	std::istringstream iss(in);
-	std::string s;
 	std::vector<std::string> tokens;
-	while (std::getline(iss, s, separator)) {
-		tokens.push_back (s);
+	size_t idx = 0, next;
+	while ((next = in.find (separator, idx)) != std::string::npos) {
+		tokens.emplace_back (in, idx, next - idx);
+		idx = next + 1;
 	}
+	if (idx < in.size ()) tokens.emplace_back (in, idx, std::string::npos);
 	return tokens;
 }
+struct Regex : public Object {
+	static constexpr const char* NAME = "regex";
+	const char* name () const { return NAME; }
+	void print (std::ostream& out) const { out << "<regex \"" << pattern << "\">"; }
+	std::string pattern;
+	std::regex re;
+	Regex (const std::string& p) : pattern (p), re (p) {}
+};
+// compiled patterns are cached per thread (dropped wholesale when full)
+std::shared_ptr<Regex> compile_regex (const std::string& pattern, AtomPtr node) {
+	thread_local std::unordered_map<std::string, std::shared_ptr<Regex>> cache;
+	auto it = cache.find (pattern);
+	if (it != cache.end ()) return it->second;
+	if (cache.size () >= 256) cache.clear ();
+	try {
+		return cache[pattern] = std::make_shared<Regex> (pattern);
+	} catch (std::regex_error& e) {
+		error ("invalid regex", node);
+	}
+	return nullptr; // dummy
+}
+// regex object or pattern string
+std::shared_ptr<Regex> regex_arg (AtomPtr a, AtomPtr node) {
+	if (a->type != OBJECT) return compile_regex (type_check (a, STRING)->lexeme, node);
+	object_check<Regex> (a);
+	return std::static_pointer_cast<Regex> (a->obj);
+}
+AtomPtr match_groups (const std::smatch& m) {
+	AtomPtr l = make_atom ();
+	for (auto& v : m) l->tail.push_back (make_string (v.str ()));
+	return l;
+}
 AtomPtr fn_string (AtomPtr node, AtomPtr env) {
 	std::string cmd = type_check (node->tail.at (0), SYMBOL)->lexeme;
 	AtomPtr l = make_atom();
-	std::regex r;
 	if (cmd == "length") { // argnum checked by default
 		return make_atom(type_check (node->tail.at(1), STRING)->lexeme.size ());
 	} else if (cmd == "find") {
@@ -614,39 +1313,508 @@ AtomPtr fn_string (AtomPtr node, AtomPtr env) {
 		else return make_atom (pos);		
 	} else if (cmd == "range") {
 		args_check (node, 4);
-		std::string tmp = type_check (node->tail.at(1), STRING)->lexeme.substr(
+		return make_string (type_check (node->tail.at(1), STRING)->lexeme.substr(
 			type_check (node->tail.at(2), NUMBER)->value, 
-			type_check (node->tail.at(3), NUMBER)->value);
-		return make_atom ((std::string) "\"" + tmp);
+			type_check (node->tail.at(3), NUMBER)->value));
 	} else if (cmd == "replace") {
 		args_check (node, 4);
-		std::string tmp = type_check (node->tail.at(1), STRING)->lexeme;
-		replace (tmp,
+		return make_string (replace (type_check (node->tail.at(1), STRING)->lexeme,
 			type_check (node->tail.at(2), STRING)->lexeme, 
-			type_check (node->tail.at(3), STRING)->lexeme);
-		return make_atom((std::string) "\"" + tmp);
+			type_check (node->tail.at(3), STRING)->lexeme));
 	} else if (cmd == "split") {
 		args_check (node, 3);
-		std::string tmp = type_check (node->tail.at(1), STRING)->lexeme;
+		const std::string& tmp = type_check (node->tail.at(1), STRING)->lexeme;
 		char sep =  type_check (node->tail.at(2), STRING)->lexeme[0];
 		std::vector<std::string> tokens = split (tmp, sep);
 		AtomPtr l = make_atom ();
-		for (unsigned i = 0; i < tokens.size (); ++i) l->tail.push_back (make_atom ((std::string) "\"" + tokens[i]));
+		l->tail.reserve (tokens.size ());
+		for (auto& t : tokens) l->tail.push_back (make_string (std::move (t)));
 		return l;
 	}else if (cmd == "regex") {
 		args_check (node, 3);
-		std::string str = type_check (node->tail.at(1), STRING)->lexeme;
-		std::regex r (type_check (node->tail.at(2), STRING)->lexeme);
+		const std::string& str = type_check (node->tail.at(1), STRING)->lexeme;
+		std::shared_ptr<Regex> r = regex_arg (node->tail.at(2), node);
 		std::smatch m; 
-		std::regex_search(str, m, r);
-		AtomPtr l = make_atom();
-		for(auto v: m) {
-			l->tail.push_back (make_atom ((std::string) "\"" + v.str()));
-		}
-		return l;		
+		std::regex_search(str, m, r->re);
+		return match_groups (m);
 	} 
 	return l;
 }
+AtomPtr fn_regex (AtomPtr node, AtomPtr env) {
+	return make_atom (compile_regex (type_check (node->tail.at (0), STRING)->lexeme, node));
+}
+// (regex-match-all str pattern) -> groups of every non-overlapping match
+AtomPtr fn_regex_match_all (AtomPtr node, AtomPtr env) {
+	const std::string& str = type_check (node->tail.at (0), STRING)->lexeme;
+	std::shared_ptr<Regex> r = regex_arg (node->tail.at (1), node);
+	AtomPtr l = make_atom ();
+	for (std::sregex_iterator it (str.begin (), str.end (), r->re), end; it != end; ++it) {
+		l->tail.push_back (match_groups (*it));
+	}
+	return l;
+}
+// growable buffer for building long strings in linear time
+struct StringBuilder : public Object {
+	static constexpr const char* NAME = "string-builder";
+	const char* name () const { return NAME; }
+	void print (std::ostream& out) const { out << "<string-builder " << buffer.size () << ">"; }
+	std::string buffer;
+};
+void builder_append (StringBuilder* b, AtomPtr a) {
+	if (a->type == STRING) b->buffer += a->lexeme;
+	else {
+		std::ostringstream out;
+		print (a, out);
+		b->buffer += out.str ();
+	}
+}
+// (string-builder [items...]); items are appended as display would show them
+AtomPtr fn_string_builder (AtomPtr node, AtomPtr env) {
+	auto b = std::make_shared<StringBuilder> ();
+	for (auto& a : node->tail) builder_append (b.get (), a);
+	return make_atom (b);
+}
+AtomPtr fn_builder_append (AtomPtr node, AtomPtr env) {
+	StringBuilder* b = object_check<StringBuilder> (node->tail.at (0));
+	for (unsigned i = 1; i < node->tail.size (); ++i) builder_append (b, node->tail.at (i));
+	return node->tail.at (0);
+}
+AtomPtr fn_builder_string (AtomPtr node, AtomPtr env) {
+	return make_string (object_check<StringBuilder> (node->tail.at (0))->buffer);
+}
+// hash tables keyed by value: lists, strings, symbols and numbers are
+// hashed and compared structurally (numbers exactly, so keys that differ
+// below eq?'s tolerance are distinct), everything else by identity
+size_t hash_atom (AtomPtr a) {
+	size_t h = std::hash<int> () (a->type);
+	auto mix = [&h] (size_t v) { h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2); };
+	switch (a->type) {
+		case LIST: for (auto& e : a->tail) mix (hash_atom (e)); break;
+		case SYMBOL: case STRING: mix (std::hash<std::string> () (a->lexeme)); break;
+		case NUMBER: mix (std::hash<Real> () (a->value == 0 ? 0 : a->value)); break; // -0 == 0
+		case OP: mix (std::hash<void*> () ((void*) a->op)); break;
+		case OBJECT: mix (std::hash<void*> () (a->obj.get ())); break;
+		default: mix (std::hash<void*> () (a.get ())); break;
+	}
+	return h;
+}
+bool key_eq (AtomPtr a, AtomPtr b) {
+	if (a->type != b->type) return false;
+	switch (a->type) {
+		case LIST:
+			if (a->tail.size () != b->tail.size ()) return false;
+			for (unsigned i = 0; i < a->tail.size (); ++i) {
+				if (!key_eq (a->tail[i], b->tail[i])) return false;
+			}
+			return true;
+		case SYMBOL: case STRING: return a->lexeme == b->lexeme;
+		case NUMBER: return a->value == b->value;
+		case OP: return a->op == b->op;
+		case OBJECT: return a->obj == b->obj;
+		default: return a == b;
+	}
+}
+struct AtomHash { size_t operator() (const AtomPtr& a) const { return hash_atom (a); } };
+struct AtomKeyEq { bool operator() (const AtomPtr& a, const AtomPtr& b) const { return key_eq (a, b); } };
+struct HashTable : public Object {
+	static constexpr const char* NAME = "hash";
+	const char* name () const { return NAME; }
+	void print (std::ostream& out) const {
+		out << "#hash(";
+		bool first = true;
+		for (auto& kv : table) {
+			out << (first ? "(" : " (");
+			::print (kv.first, out, true) << " ";
+			::print (kv.second, out, true) << ")";
+			first = false;
+		}
+		out << ")";
+	}
+	std::unordered_map<AtomPtr, AtomPtr, AtomHash, AtomKeyEq> table;
+};
+AtomPtr fn_make_hash (AtomPtr node, AtomPtr env) {
+	return make_atom (std::make_shared<HashTable> ());
+}
+AtomPtr fn_hash_set (AtomPtr node, AtomPtr env) {
+	object_check<HashTable> (node->tail.at (0))->table[node->tail.at (1)] = node->tail.at (2);
+	return node->tail.at (2);
+}
+// (hash-ref h key [default]): missing keys are an error without a default
+AtomPtr fn_hash_ref (AtomPtr node, AtomPtr env) {
+	HashTable* h = object_check<HashTable> (node->tail.at (0));
+	auto it = h->table.find (node->tail.at (1));
+	if (it != h->table.end ()) return it->second;
+	if (node->tail.size () > 2) return node->tail.at (2);
+	error ("key not found", node->tail.at (1));
+	return nullptr; // dummy
+}
+AtomPtr fn_hash_remove (AtomPtr node, AtomPtr env) {
+	return make_atom ((Real) object_check<HashTable> (node->tail.at (0))->table.erase (node->tail.at (1)));
+}
+AtomPtr fn_hash_keys (AtomPtr node, AtomPtr env) {
+	HashTable* h = object_check<HashTable> (node->tail.at (0));
+	AtomPtr l = make_atom ();
+	l->tail.reserve (h->table.size ());
+	for (auto& kv : h->table) l->tail.push_back (kv.first);
+	return l;
+}
+AtomPtr fn_hash_count (AtomPtr node, AtomPtr env) {
+	return make_atom ((Real) object_check<HashTable> (node->tail.at (0))->table.size ());
+}
+AtomPtr fn_force (AtomPtr node, AtomPtr env) {
+	AtomPtr p = node->tail.at (0);
+	if (p->type != OBJECT || !dynamic_cast<Promise*> (p->obj.get ())) return p; // force of a value is the value
+	Promise* pr = (Promise*) p->obj.get ();
+	if (pr->value == nullptr) {
+		AtomPtr v = eval (pr->expr, pr->env);
+		if (pr->value == nullptr) pr->value = v; // a reentrant force may have won
+		pr->expr = pr->env = nullptr;
+	}
+	return pr->value;
+}
+// lazy sequences: a stream describes a pipeline and each consumer opens its
+// own generator on it, so nothing is materialized, only the consumed items
+// are computed and the same stream can be traversed more than once
+typedef std::function<bool (AtomPtr&)> Generator; // false when exhausted
+struct Stream : public Object {
+	static constexpr const char* NAME = "stream";
+	const char* name () const { return NAME; }
+	Stream (std::function<Generator ()> o) : open (o) {}
+	std::function<Generator ()> open;
+};
+AtomPtr make_stream (std::function<Generator ()> open) {
+	return make_atom (std::make_shared<Stream> (open));
+}
+// (stream-range start [end [step]]): unbounded without end
+AtomPtr fn_stream_range (AtomPtr node, AtomPtr env) {
+	Real start = type_check (node->tail.at (0), NUMBER)->value;
+	bool bounded = node->tail.size () > 1;
+	Real end = bounded ? type_check (node->tail.at (1), NUMBER)->value : 0;
+	Real step = node->tail.size () > 2 ? type_check (node->tail.at (2), NUMBER)->value : 1;
+	if (step == 0) error ("invalid step", node);
+	return make_stream ([=] () -> Generator {
+		Real x = start;
+		return [=] (AtomPtr& out) mutable {
+			if (bounded && (step > 0 ? x >= end : x <= end)) return false;
+			out = make_atom (x);
+			x += step;
+			return true;
+		};
+	});
+}
+// (stream-iterate f x): x, (f x), (f (f x)), ...
+AtomPtr fn_stream_iterate (AtomPtr node, AtomPtr env) {
+	AtomPtr f = node->tail.at (0), x0 = node->tail.at (1);
+	return make_stream ([=] () -> Generator {
+		AtomPtr x;
+		return [=] (AtomPtr& out) mutable {
+			x = x ? call (f, {x}, env) : x0;
+			out = x;
+			return true;
+		};
+	});
+}
+AtomPtr fn_list_stream (AtomPtr node, AtomPtr env) {
+	AtomPtr l = type_check (node->tail.at (0), LIST);
+	return make_stream ([=] () -> Generator {
+		size_t i = 0;
+		return [=] (AtomPtr& out) mutable {
+			if (i >= l->tail.size ()) return false;
+			out = l->tail[i++];
+			return true;
+		};
+	});
+}
+// (stream-lines filename): lines of a text file, read as they are consumed
+AtomPtr fn_stream_lines (AtomPtr node, AtomPtr env) {
+	std::string filename = type_check (node->tail.at (0), STRING)->lexeme;
+	return make_stream ([=] () -> Generator {
+		auto in = std::make_shared<std::ifstream> (filename);
+		if (!in->good ()) error ("cannot open input file", node);
+		return [=] (AtomPtr& out) {
+			std::string line;
+			if (!std::getline (*in, line)) return false;
+			out = make_string (line);
+			return true;
+		};
+	});
+}
+Stream* stream_arg (AtomPtr a) { return object_check<Stream> (a); }
+// (stream-map f s1 s2 ...): stops at the shortest stream
+AtomPtr fn_stream_map (AtomPtr node, AtomPtr env) {
+	AtomPtr f = node->tail.at (0);
+	std::vector<AtomPtr> sources (node->tail.begin () + 1, node->tail.end ());
+	for (auto& s : sources) stream_arg (s);
+	return make_stream ([=] () -> Generator {
+		std::vector<Generator> gens;
+		for (auto& s : sources) gens.push_back (((Stream*) s->obj.get ())->open ());
+		return [=] (AtomPtr& out) mutable {
+			std::vector<AtomPtr> args (gens.size ());
+			for (size_t i = 0; i < gens.size (); ++i) if (!gens[i] (args[i])) return false;
+			out = call (f, args, env);
+			return true;
+		};
+	});
+}
+AtomPtr fn_stream_filter (AtomPtr node, AtomPtr env) {
+	AtomPtr pred = node->tail.at (0);
+	Stream* s = stream_arg (node->tail.at (1));
+	auto open = s->open;
+	return make_stream ([=] () -> Generator {
+		Generator g = open ();
+		return [=] (AtomPtr& out) mutable {
+			while (g (out)) {
+				if (type_check (call (pred, {out}, env), NUMBER)->value) return true;
+			}
+			return false;
+		};
+	});
+}
+AtomPtr fn_stream_take (AtomPtr node, AtomPtr env) {
+	Real n = type_check (node->tail.at (0), NUMBER)->value;
+	auto open = stream_arg (node->tail.at (1))->open;
+	return make_stream ([=] () -> Generator {
+		Generator g = open ();
+		Real left = n;
+		return [=] (AtomPtr& out) mutable {
+			if (left < 1 || !g (out)) return false; // never pulls past the n-th item
+			--left;
+			return true;
+		};
+	});
+}
+AtomPtr fn_stream_drop (AtomPtr node, AtomPtr env) {
+	Real n = type_check (node->tail.at (0), NUMBER)->value;
+	auto open = stream_arg (node->tail.at (1))->open;
+	return make_stream ([=] () -> Generator {
+		Generator g = open ();
+		Real skip = n;
+		return [=] (AtomPtr& out) mutable {
+			for (; skip >= 1; --skip) if (!g (out)) return false;
+			return g (out);
+		};
+	});
+}
+// (stream-fold f init s): same argument order as fold, (f item acc)
+AtomPtr fn_stream_fold (AtomPtr node, AtomPtr env) {
+	AtomPtr f = node->tail.at (0), acc = node->tail.at (1);
+	Generator g = stream_arg (node->tail.at (2))->open ();
+	AtomPtr x;
+	while (g (x)) acc = call (f, {x, acc}, env);
+	return acc;
+}
+AtomPtr fn_stream_list (AtomPtr node, AtomPtr env) {
+	Generator g = stream_arg (node->tail.at (0))->open ();
+	AtomPtr l = make_atom (), x;
+	while (g (x)) l->tail.push_back (x);
+	return l;
+}
+// futures: (future expr) evaluates expr on a background worker and returns a
+// handle that await turns into the value (rethrowing its error). For a call
+// to a native primitive, like (future (readwav "next.wav")), the arguments
+// are evaluated at once and only the primitive runs in the background;
+// other expressions run entirely on the worker in a child environment.
+// Awaiting a future that no worker has started yet runs it inline, so
+// futures can wait on each other without exhausting the pool. Bindings are
+// locked (see env_lock), but values are not: a future must not mutate a
+// vector, hash table or string builder that another thread is using
+// (vector-set!, hash-set!, builder-append!). At exit, futures still running
+// are waited for and queued ones are dropped
+struct Future : public Object {
+	static constexpr const char* NAME = "future";
+	const char* name () const { return NAME; }
+	bool claim () {
+		int pending = 0;
+		return state.compare_exchange_strong (pending, 1);
+	}
+	void run () {
+		try {
+			value = job ();
+		} catch (std::exception& e) {
+			failure = e.what ();
+			failed = true;
+		} catch (...) {
+			failure = "unknown error detected";
+			failed = true;
+		}
+		job = nullptr;
+		std::lock_guard<std::mutex> guard (lock);
+		state = 2;
+		finished.notify_all ();
+	}
+	AtomPtr wait () {
+		if (claim ()) run ();
+		else {
+			std::unique_lock<std::mutex> guard (lock);
+			finished.wait (guard, [this] { return state == 2; });
+		}
+		if (failed) throw std::runtime_error (failure);
+		return value;
+	}
+	std::function<AtomPtr ()> job;
+	std::atomic<int> state {0}; // pending, running, done
+	std::mutex lock;
+	std::condition_variable finished;
+	AtomPtr value;
+	std::string failure;
+	bool failed = false;
+};
+struct FuturePool {
+	FuturePool () {
+		unsigned n = std::max (2u, std::thread::hardware_concurrency ());
+		for (unsigned i = 0; i < n; ++i) workers.emplace_back ([this] { work (); });
+	}
+	~FuturePool () { // before the globals the jobs use, which were built earlier
+		{
+			std::lock_guard<std::mutex> guard (lock);
+			stopping = true;
+			jobs.clear ();
+		}
+		ready.notify_all ();
+		for (auto& t : workers) {
+			if (t.get_id () == std::this_thread::get_id ()) t.detach (); // exit called by a future
+			else t.join ();
+		}
+	}
+	void push (std::shared_ptr<Future> f) {
+		std::lock_guard<std::mutex> guard (lock);
+		jobs.push_back (f);
+		ready.notify_one ();
+	}
+	void work () {
+		while (true) {
+			std::unique_lock<std::mutex> guard (lock);
+			ready.wait (guard, [this] { return stopping || !jobs.empty (); });
+			if (stopping) return;
+			std::shared_ptr<Future> f = jobs.front ();
+			jobs.pop_front ();
+			guard.unlock ();
+			if (f->claim ()) f->run ();
+		}
+	}
+	std::mutex lock;
+	std::condition_variable ready;
+	std::deque<std::shared_ptr<Future>> jobs;
+	std::vector<std::thread> workers;
+	bool stopping = false;
+};
+AtomPtr spawn_future (AtomPtr expr, AtomPtr env) {
+	static FuturePool pool;
+	auto f = std::make_shared<Future> ();
+	AtomPtr func = expr->type == LIST && expr->tail.size () && expr->tail.at (0)->type == SYMBOL
+		? lookup (expr->tail.at (0), env) : nullptr;
+	if (func && func->type == OP && func->minargs != (unsigned) -1 && func->op != &fn_eval && func->op != &fn_apply) {
+		AtomPtr args = make_atom ();
+		for (unsigned i = 1; i < expr->tail.size (); ++i) args->tail.push_back (eval (expr->tail.at (i), env));
+		args_check (args, func->minargs);
+		f->job = [func, args, env] { return func->op (args, env); };
+	} else {
+		AtomPtr nenv = make_atom ();
+		nenv->tail.push_back (env);
+		f->job = [expr, nenv] { return eval (expr, nenv); };
+	}
+	futures_started = true;
+	pool.push (f);
+	return make_atom (f);
+}
+AtomPtr fn_await (AtomPtr node, AtomPtr env) {
+	AtomPtr f = node->tail.at (0);
+	if (f->type != OBJECT || !dynamic_cast<Future*> (f->obj.get ())) return f; // await of a value is the value
+	return ((Future*) f->obj.get ())->wait ();
+}
+AtomPtr fn_await_all (AtomPtr node, AtomPtr env) {
+	AtomPtr l = make_atom ();
+	for (auto& f : type_check (node->tail.at (0), LIST)->tail) {
+		AtomPtr q = make_atom ();
+		q->tail.push_back (f);
+		l->tail.push_back (fn_await (q, env));
+	}
+	return l;
+}
+AtomPtr fn_future_ready (AtomPtr node, AtomPtr env) {
+	return make_atom ((Real) (object_check<Future> (node->tail.at (0))->state == 2));
+}
+// memoized functions: a bounded LRU cache keyed by the argument list, hashed
+// and compared like hash table keys; the wrapped lambda is usually rebound to
+// the same name so that its recursive calls go through the cache as well
+struct Memo : public Object {
+	static constexpr const char* NAME = "memo";
+	const char* name () const { return NAME; }
+	bool callable () const { return true; }
+	AtomPtr apply (AtomPtr args, AtomPtr node, AtomPtr env, AtomPtr& next) {
+		std::lock_guard<std::mutex> guard (lock);
+		auto it = index.find (args);
+		if (it != index.end ()) {
+			++hits;
+			entries.splice (entries.begin (), entries, it->second); // most recent first
+			return it->second->second;
+		}
+		++misses;
+		next = func; // eval applies it and hands the result to complete
+		return nullptr;
+	}
+	void complete (AtomPtr args, AtomPtr r) {
+		std::lock_guard<std::mutex> guard (lock);
+		if (index.find (args) == index.end ()) {
+			entries.emplace_front (args, r);
+			index[args] = entries.begin ();
+			if (entries.size () > capacity) {
+				index.erase (entries.back ().first);
+				entries.pop_back ();
+				++evictions;
+			}
+		}
+	}
+	AtomPtr func;
+	size_t capacity;
+	size_t hits = 0, misses = 0, evictions = 0;
+	std::list<std::pair<AtomPtr, AtomPtr>> entries;
+	std::unordered_map<AtomPtr, std::list<std::pair<AtomPtr, AtomPtr>>::iterator, AtomHash, AtomKeyEq> index;
+	std::mutex lock;
+};
+// (memoize f [capacity]): capacity defaults to 4096 entries
+AtomPtr fn_memoize (AtomPtr node, AtomPtr env) {
+	auto m = std::make_shared<Memo> ();
+	m->func = type_check (node->tail.at (0), LAMBDA);
+	Real capacity = node->tail.size () > 1 ? type_check (node->tail.at (1), NUMBER)->value : 4096;
+	if (capacity < 1) error ("invalid memo capacity", node->tail.at (1));
+	m->capacity = (size_t) capacity;
+	return make_atom (m);
+}
+AtomPtr fn_memo_stats (AtomPtr node, AtomPtr env) {
+	Memo* m = object_check<Memo> (node->tail.at (0));
+	std::lock_guard<std::mutex> guard (m->lock);
+	AtomPtr l = make_atom ();
+	auto field = [&l] (const char* key, size_t v) {
+		AtomPtr kv = make_atom ();
+		kv->tail.push_back (make_atom (std::string (key)));
+		kv->tail.push_back (make_atom ((Real) v));
+		l->tail.push_back (kv);
+	};
+	field ("hits", m->hits);
+	field ("misses", m->misses);
+	field ("evictions", m->evictions);
+	field ("size", m->entries.size ());
+	field ("capacity", m->capacity);
+	return l;
+}
+AtomPtr fn_memo_clear (AtomPtr node, AtomPtr env) {
+	Memo* m = object_check<Memo> (node->tail.at (0));
+	std::lock_guard<std::mutex> guard (m->lock);
+	m->entries.clear ();
+	m->index.clear ();
+	m->hits = m->misses = m->evictions = 0;
+	return node->tail.at (0);
+}
+// (stack-limit [n]): maximum number of pending evaluations, set when n is given
+AtomPtr fn_stack_limit (AtomPtr node, AtomPtr env) {
+	if (node->tail.size ()) {
+		Real n = type_check (node->tail.at (0), NUMBER)->value;
+		if (n < 1) error ("invalid stack limit", node->tail.at (0));
+		stack_limit = (size_t) n;
+	}
+	return make_atom ((Real) stack_limit);
+}
 AtomPtr fn_exec (AtomPtr node, AtomPtr env) {
 	return make_atom (system (type_check (node->tail.at (0), STRING)->lexeme.c_str ()));
 }
@@ -681,12 +1849,19 @@ AtomPtr make_env () {
 	add_op ("cons", &fn_cons, 2, env);
 	add_op ("car", &fn_car, 1, env);
 	add_op ("cdr", &fn_cdr, 1, env);
+	add_op ("make-vector", &fn_make_vector, 1, env);
+	add_op ("vector-ref", &fn_vector_ref, 2, env);
+	add_op ("vector-set!", &fn_vector_set, 3, env);
+	add_op ("vector-length", &fn_vector_length, 1, env);
+	add_op ("subvector", &fn_subvector, 2, env);
 	add_op ("eq?", &fn_eq, 2, env);
 	add_op ("type", &fn_type, 1, env);
 	add_op ("display", &fn_print<false>, 1, env);
 	add_op ("save", &fn_print<true>, 2, env);
 	add_op ("read", &fn_read, 0, env);
 	add_op ("load", &fn_load, 0, env);
+	add_op ("require", &fn_require, 1, env);
+	add_op ("provide", &fn_provide, -1, env);
 	add_op ("+", &fn_add, 1, env);
 	add_op ("-", &fn_sub, 1, env);
 	add_op ("*", &fn_mul, 1, env);
@@ -708,7 +1883,40 @@ AtomPtr make_env () {
 	add_op ("pow", &fn_pow, 2, env);
 	add_op ("atan2", &fn_atan2, 2, env);
 	add_op ("random", &fn_random, 1, env);
+	add_op ("seed", &fn_seed, 1, env);
+	add_op ("shuffle", &fn_shuffle, 1, env);
 	add_op ("string", &fn_string, 2, env);
+	add_op ("regex", &fn_regex, 1, env);
+	add_op ("regex-match-all", &fn_regex_match_all, 2, env);
+	add_op ("string-builder", &fn_string_builder, 0, env);
+	add_op ("builder-append!", &fn_builder_append, 2, env);
+	add_op ("builder->string", &fn_builder_string, 1, env);
+	add_op ("make-hash", &fn_make_hash, 0, env);
+	add_op ("hash-set!", &fn_hash_set, 3, env);
+	add_op ("hash-ref", &fn_hash_ref, 2, env);
+	add_op ("hash-remove!", &fn_hash_remove, 2, env);
+	add_op ("hash-keys", &fn_hash_keys, 1, env);
+	add_op ("hash-count", &fn_hash_count, 1, env);
+	add_op ("delay", &fn_delay, -1, env);
+	add_op ("force", &fn_force, 1, env);
+	add_op ("stream-range", &fn_stream_range, 1, env);
+	add_op ("stream-iterate", &fn_stream_iterate, 2, env);
+	add_op ("list->stream", &fn_list_stream, 1, env);
+	add_op ("stream-lines", &fn_stream_lines, 1, env);
+	add_op ("stream-map", &fn_stream_map, 2, env);
+	add_op ("stream-filter", &fn_stream_filter, 2, env);
+	add_op ("stream-take", &fn_stream_take, 2, env);
+	add_op ("stream-drop", &fn_stream_drop, 2, env);
+	add_op ("stream-fold", &fn_stream_fold, 3, env);
+	add_op ("stream->list", &fn_stream_list, 1, env);
+	add_op ("future", &fn_future, -1, env);
+	add_op ("await", &fn_await, 1, env);
+	add_op ("await-all", &fn_await_all, 1, env);
+	add_op ("future-ready?", &fn_future_ready, 1, env);
+	add_op ("memoize", &fn_memoize, 1, env);
+	add_op ("memo-stats", &fn_memo_stats, 1, env);
+	add_op ("memo-clear!", &fn_memo_clear, 1, env);
+	add_op ("stack-limit", &fn_stack_limit, 0, env);
 	add_op ("exec", &fn_exec, 1, env);
 	add_op ("exit", &fn_exit, 0, env);
 	return env;
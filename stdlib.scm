@@ -33,39 +33,46 @@
 
 (define map
   (lambda (f lst)
-    (define map-iter
-      (lambda (l acc)
-        (if (eq? l '())
-            (reverse acc)
-            (map-iter (cdr l) (cons (f (car l)) acc)))))
-    (map-iter lst '())))
+    (define n (vector-length lst))
+    (define out (make-vector n))
+    (define i 0)
+    (while (< i n)
+      (begin
+        (vector-set! out i (f (vector-ref lst i)))
+        (set! i (+ i 1))))
+    out))
 
 (define fold
   (lambda (f init lst)
-    (define fold-iter
-      (lambda (l acc)
-        (if (eq? l '())
-            acc
-            (fold-iter (cdr l) (f (car l) acc)))))
-    (fold-iter lst init)))
+    (define n (vector-length lst))
+    (define acc init)
+    (define i 0)
+    (while (< i n)
+      (begin
+        (set! acc (f (vector-ref lst i) acc))
+        (set! i (+ i 1))))
+    acc))
 
 (define range
   (lambda (start end)
-    (define range-iter
-      (lambda (s acc)
-        (if (>= s end)
-            (reverse acc)
-            (range-iter (+ s 1) (cons s acc)))))
-    (range-iter start '())))
+    (define n (if (> end start) (- 0 (floor (- start end))) 0))
+    (define out (make-vector n))
+    (define i 0)
+    (while (< i n)
+      (begin
+        (vector-set! out i (+ start i))
+        (set! i (+ i 1))))
+    out))
 
 (define iterate
   (lambda (f x n)
-    (define iterate-iter
-      (lambda (count acc)
-        (if (eq? count 0)
-            (reverse acc)
-            (iterate-iter (- count 1) (cons (f (car acc)) acc)))))
-    (iterate-iter n (list x))))
+    (define out (make-vector (+ n 1) x))
+    (define i 1)
+    (while (<= i n)
+      (begin
+        (vector-set! out i (f (vector-ref out (- i 1))))
+        (set! i (+ i 1))))
+    out))
 
 ;; --- list manipulation ---
 
@@ -75,144 +82,118 @@
 
 (define filter
   (lambda (pred lst)
-    (define filter-iter
-      (lambda (l acc)
-        (if (eq? l '())
-            (reverse acc)
-            (filter-iter (cdr l)
-                         (if (pred (car l))
-                             (cons (car l) acc)
-                             acc)))))
-    (filter-iter lst '())))
+    (define n (vector-length lst))
+    (define out (make-vector n))
+    (define i 0)
+    (define j 0)
+    (while (< i n)
+      (begin
+        (if (pred (vector-ref lst i))
+            (begin
+              (vector-set! out j (vector-ref lst i))
+              (set! j (+ j 1))))
+        (set! i (+ i 1))))
+    (subvector out 0 j)))
 
 (define element
   (lambda (x lst)
-    (define element-iter
-      (lambda (l)
-        (if (eq? l '())
-            0
-            (if (eq? (car l) x)
-                1
-                (element-iter (cdr l))))))
-    (element-iter lst)))
+    (define n (vector-length lst))
+    (define i 0)
+    (while (if (< i n) (not (eq? (vector-ref lst i) x)) 0)
+      (set! i (+ i 1)))
+    (if (< i n) 1 0)))
 
 (define reverse
   (lambda (lst)
-    (define reverse-iter
-      (lambda (l acc)
-        (if (eq? l '())
-            acc
-            (reverse-iter (cdr l) (cons (car l) acc)))))
-    (reverse-iter lst '())))
+    (define n (vector-length lst))
+    (define out (make-vector n))
+    (define i 0)
+    (while (< i n)
+      (begin
+        (vector-set! out (- n i 1) (vector-ref lst i))
+        (set! i (+ i 1))))
+    out))
 
 (define append
   (lambda (lst1 lst2)
-    (fold (lambda (x acc) (cons x acc))
-          lst2
-          (reverse lst1))))
+    (define n1 (vector-length lst1))
+    (define n2 (vector-length lst2))
+    (define out (make-vector (+ n1 n2)))
+    (define i 0)
+    (while (< i n1)
+      (begin
+        (vector-set! out i (vector-ref lst1 i))
+        (set! i (+ i 1))))
+    (while (< i (+ n1 n2))
+      (begin
+        (vector-set! out i (vector-ref lst2 (- i n1)))
+        (set! i (+ i 1))))
+    out))
 
 (define length
   (lambda (lst)
-    (define length-iter
-      (lambda (l acc)
-        (if (eq? l '())
-            acc
-            (length-iter (cdr l) (+ acc 1)))))
-    (length-iter lst 0)))
+    (vector-length lst)))
 
 (define assoc
   (lambda (key lst)
-    (define assoc-iter
-      (lambda (l)
-        (if (eq? l '())
-            0
-            (if (eq? (car (car l)) key)
-                (car l)
-                (assoc-iter (cdr l))))))
-    (assoc-iter lst)))
+    (define n (vector-length lst))
+    (define i 0)
+    (while (if (< i n) (not (eq? (car (vector-ref lst i)) key)) 0)
+      (set! i (+ i 1)))
+    (if (< i n) (vector-ref lst i) 0)))
 
 (define memq
   (lambda (x lst)
-    (define memq-iter
-      (lambda (l)
-        (if (eq? l '())
-            0
-            (if (eq? (car l) x)
-                l
-                (memq-iter (cdr l))))))
-    (memq-iter lst)))
+    (define n (vector-length lst))
+    (define i 0)
+    (while (if (< i n) (not (eq? (vector-ref lst i) x)) 0)
+      (set! i (+ i 1)))
+    (if (< i n) (subvector lst i) 0)))
 
 (define remove
   (lambda (x lst)
-    (define remove-iter
-      (lambda (l acc)
-        (if (eq? l '())
-            (reverse acc)
-            (remove-iter (cdr l)
-                         (if (eq? (car l) x)
-                             acc
-                             (cons (car l) acc))))))
-    (remove-iter lst '())))
+    (filter (lambda (e) (not (eq? e x))) lst)))
 
 (define find
   (lambda (pred lst)
-    (define find-iter
-      (lambda (l)
-        (if (eq? l '())
-            0
-            (if (pred (car l))
-                (car l)
-                (find-iter (cdr l))))))
-    (find-iter lst)))
+    (define n (vector-length lst))
+    (define i 0)
+    (while (if (< i n) (not (pred (vector-ref lst i))) 0)
+      (set! i (+ i 1)))
+    (if (< i n) (vector-ref lst i) 0)))
 
 (define forall
   (lambda (pred lst)
-    (define forall-iter
-      (lambda (l)
-        (if (eq? l '())
-            1
-            (if (pred (car l))
-                (forall-iter (cdr l))
-                0))))
-    (forall-iter lst)))
+    (define n (vector-length lst))
+    (define i 0)
+    (while (if (< i n) (pred (vector-ref lst i)) 0)
+      (set! i (+ i 1)))
+    (if (< i n) 0 1)))
 
 (define exists
   (lambda (pred lst)
-    (define exists-iter
-      (lambda (l)
-        (if (eq? l '())
-            0
-            (if (pred (car l))
-                1
-                (exists-iter (cdr l))))))
-    (exists-iter lst)))
+    (define n (vector-length lst))
+    (define i 0)
+    (while (if (< i n) (not (pred (vector-ref lst i))) 0)
+      (set! i (+ i 1)))
+    (if (< i n) 1 0)))
 
 (define last
   (lambda (lst)
-    (define last-iter
-      (lambda (l)
-        (if (eq? (cdr l) '())
-            (car l)
-            (last-iter (cdr l)))))
-    (last-iter lst)))
+    (vector-ref lst (- (vector-length lst) 1))))
+
+(define clamp-count
+  (lambda (n lst)
+    (define k (floor n))
+    (if (< k 0) 0 (if (< k (vector-length lst)) k (vector-length lst)))))
 
 (define take
   (lambda (n lst)
-    (define take-iter
-      (lambda (count l acc)
-        (if (or (eq? count 0) (eq? l '()))
-            (reverse acc)
-            (take-iter (- count 1) (cdr l) (cons (car l) acc)))))
-    (take-iter n lst '())))
+    (subvector lst 0 (clamp-count n lst))))
 
 (define drop
   (lambda (n lst)
-    (define drop-iter
-      (lambda (count l)
-        (if (or (eq? count 0) (eq? l '()))
-            l
-            (drop-iter (- count 1) (cdr l)))))
-    (drop-iter n lst)))
+    (subvector lst (clamp-count n lst))))
 
 (define flatten
   (lambda (lst)
@@ -226,27 +207,14 @@
 
 (define zip
   (lambda (lst1 lst2)
-    (if (or (eq? lst1 '()) (eq? lst2 '()))
-        '()
-        (cons (list (car lst1) (car lst2)) (zip (cdr lst1) (cdr lst2)))))
-)
-
-(define shuffle
-  (lambda (lst)
-    (define n (length lst))
-    (define vec lst) ; Assume list is a vector-like flat list
-    (define i (- n 1))
-    (while (> i 0)
+    (define n (if (< (vector-length lst1) (vector-length lst2)) (vector-length lst1) (vector-length lst2)))
+    (define out (make-vector n))
+    (define i 0)
+    (while (< i n)
       (begin
-        (define j (mod (car (random 1)) (+ i 1)))
-        (define tmp (car (drop j vec)))
-        (set! vec
-              (append
-                (take j vec)
-                (cons (car (drop i vec))
-                      (append (drop (+ j 1) (take i vec)) (list tmp)))))
-        (set! i (- i 1))))
-    vec))
+        (vector-set! out i (list (vector-ref lst1 i) (vector-ref lst2 i)))
+        (set! i (+ i 1))))
+    out))
 
 (define unzip
   (lambda (lst)
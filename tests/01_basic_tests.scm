@@ -74,6 +74,56 @@
 (test (string 'find "hello world" "world") 6)
 (test (string 'range "hello world" 0 5) "hello")
 (test (car (string 'split "a,b,c" ",")) "a")
+(test (length (string 'split "a,,b," ",")) 3)
+(test (string 'replace "aaa" "a" "bb") "bbbbbb")
+(test (string 'regex "id=42" "id=([0-9]+)") ("id=42" "42"))
+(test (regex-match-all "1 22 333" (regex "[0-9]+")) (("1") ("22") ("333")))
+(define sb (string-builder "x=" 1.5))
+(builder-append! sb " " "y")
+(test (builder->string sb) "x=1.5 y")
+
+;; --- Vectors ---
+(define v (make-vector 3 0))
+(vector-set! v 1 'x)
+(test v (0 x 0))
+(test (vector-ref (list 5 6 7) 2) 7)
+(test (vector-length v) 3)
+(test (subvector (list 1 2 3 4) 1 3) (2 3))
+(test (subvector (list 1 2 3 4) 2) (3 4))
+
+;; --- Hash tables ---
+(define h (make-hash))
+(hash-set! h "a" 1)
+(hash-set! h 'a 2)
+(hash-set! h (list 1 2) 3)
+(test (hash-ref h "a") 1)
+(test (hash-ref h 'a) 2)
+(test (hash-ref h (list 1 2)) 3)
+(test (hash-ref h 'b 0) 0)
+(test (hash-remove! h 'a) 1)
+(test (hash-count h) 2)
+
+;; --- Promises and streams ---
+(define forced 0)
+(define p (delay (begin (set! forced (+ forced 1)) 42)))
+(test (force p) 42)
+(test (force p) 42)
+(test forced 1)
+(define squares (stream-map (lambda (x) (* x x)) (stream-range 0)))
+(test (stream->list (stream-take 4 squares)) (0 1 4 9))
+(test (stream->list (stream-take 2 (stream-filter (lambda (x) (> x 10)) squares))) (16 25))
+(test (stream-fold + 0 (stream-range 0 100000)) 4999950000)
+(test (stream->list (stream-map + (stream-range 0 10) (list->stream (list 10 20)))) (10 21))
+(test (stream->list (stream-drop 3 (stream-take 5 (stream-iterate (lambda (x) (* 2 x)) 1)))) (8 16))
+
+;; --- Futures ---
+(define f (future (+ 1 2)))
+(define g (future (begin (define local 4) (* local 10))))
+(test (await f) 3)
+(test (await-all (list f g 5)) (3 40 5))
+(test (future-ready? f) 1)
+(test (await (future (await (future (* 6 7))))) 42)
+(test (type f) future)
 
 ;; --- Recursion: factorial ---
 (define factorial
@@ -103,6 +153,42 @@
 (test (fib 5) 5)
 (test (fib 7) 13)
 
+;; --- Deep recursion ---
+(define count (lambda (n) (if (eq? n 0) 0 (+ 1 (count (- n 1))))))
+(test (count 50000) 50000)
+(define nest (lambda (n) (if (eq? n 0) () (list n (nest (- n 1))))))
+(define deep (nest 50000))
+(test (eq? deep (nest 50000)) 1)
+(test (string 'length (builder->string (string-builder deep))) 388896)
+(test (stack-limit) 1000000)
+(stack-limit 64)
+(test (count 20) 20)
+(define reached 0)
+(begin (count 1000) (set! reached 1)) ; reports "stack overflow" and abandons the form
+(test reached 0)
+(stack-limit 1000000)
+(test (count 1000) 1000)
+
+;; --- Memoization ---
+
+(define fib (memoize fib))
+(test (fib 60) 1548008755920)
+(test (car (cdr (car (memo-stats fib)))) 58) ; hits
+(test (car (cdr (car (cdr (memo-stats fib))))) 61) ; misses
+(define down (memoize (lambda (n) (if (eq? n 0) 0 (down (- n 1)))) 2))
+(test (down 5) 0)
+(test (car (cdr (car (cdr (cdr (memo-stats down)))))) 4) ; evictions
+(test (type down) memo)
+
+;; --- random numbers ---
+
+(seed 7)
+(define r (random 3))
+(seed 7)
+(test (eq? (random 3) r) 1)
+(test (length (shuffle (list 1 2 3 4 5))) 5)
+(test (fold + 0 (shuffle (list 1 2 3 4 5))) 15)
+
 (display "\n--- Tests completed ---\n")
 
 ;;  eof
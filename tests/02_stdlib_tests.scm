@@ -8,19 +8,28 @@
 (test (map (lambda (x) (+ x 1)) (list 1 2 3)) (2 3 4))
 (test (fold + 0 (list 1 2 3 4)) 10)
 (test (range 0 5) (0 1 2 3 4))
+(test (range 0.5 3) (0.5 1.5 2.5))
 (test (filter (lambda (x) (eq? x 2)) (list 1 2 3 2 4)) (2 2))
 (test (element 2 (list 1 2 3)) 1)
+(test (element 5 (list 1 2 3)) 0)
 (test (reverse (list 1 2 3)) (3 2 1))
 (test (append (list 1 2) (list 3 4)) (1 2 3 4))
 (test (assoc 'a (list (list 'a 1) (list 'b 2))) (a 1))
 (test (memq 'b (list 'a 'b 'c)) (b c))
 (test (remove 2 (list 1 2 3 2 4)) (1 3 4))
 (test (find (lambda (x) (eq? x 3)) (list 1 2 3 4)) 3)
-; (test (forall (lambda (x) (>= x 0)) (list 1 2 3)) 1)
+(test (forall (lambda (x) (>= x 0)) (list 1 2 3)) 1)
+(test (forall (lambda (x) (> x 1)) (list 1 2 3)) 0)
 (test (exists (lambda (x) (eq? x 2)) (list 1 2 3)) 1)
 (test (last (list 1 2 3 4)) 4)
 (test (take 3 (list 1 2 3 4 5)) (1 2 3))
 (test (drop 2 (list 1 2 3 4)) (3 4))
+(test (take 9 (list 1 2)) (1 2))
+(test (take -1 (list 1 2)) ())
+(test (take 1.5 (list 1 2 3)) (1))
+(test (drop 2.5 (list 1 2 3 4)) (3 4))
+(test (drop -3 (list 1 2)) (1 2))
+(test (iterate (lambda (x) (* x 2)) 1 3) (1 2 4 8))
 (test (flatten (list (list 1 2) (list 3 4))) (1 2 3 4))
 (test (zip (list 1 2) (list 'a 'b)) ((1 a) (2 b)))
 
@@ -34,6 +43,17 @@
 (test (or 0 0) 0)
 (test (or 0 1) 1)
 
+;; --- modules ---
+
+(define imported (require "tests/modules/geometry.scm"))
+(test imported (circle-area square))
+(test (square 3) 9)
+(define imported (require "tests/modules/geometry.scm" 'geo))
+(test imported (geo:circle-area geo:square))
+(test (geo:circle-area 1) 3.141592653589793)
+(define names (env))
+(test (memq 'pi names) 0) ; unexported names stay inside the module
+
 ;; --- stress test with large list ---
 
 (test (length (range 0 10000)) 10000)
@@ -7,14 +7,85 @@
 (test (mean (list 1 2 3 4 5)) 3)
 (test (variance (list 1 2 3 4 5)) 2)
 (test (stddev (list 1 2 3 4 5)) 1.4142135623731)
+(test (matrix-shape (random-normal (list 2 3))) (2 3))
+(test (car (minmax (random-int 1000 1 6))) 1)
+(test (car (cdr (minmax (random-int 1000 1 6)))) 6)
+(test (< (abs (- (mean (random-normal 100000 5 2)) 5)) 0.05) 1)
+(define st (stats-new (list 1 2 3)))
+(stats-push st (list 4 5))
+(test (variance st) 2)
+(test (mean (stats-merge (stats-new (list 1 2)) (stats-new 3 (list 4 5)))) 3)
+(test (describe (list 1 2 3 4 5)) ((count 5) (mean 3) (variance 2) (stddev 1.41421356237310) (min 1) (max 5) (skewness 0) (kurtosis -1.3)))
+(test (sort (list 3 1 2 1.5)) (1 1.5 2 3))
+(test (sort (list 3 1 2) >) (3 2 1))
+(test (sort (list "b" "c" "a")) ("a" "b" "c"))
+(test (sort (list (list 2 'a) (list 1 'b) (list 2 'c) (list 1 'd)) (lambda (x y) (< (car x) (car y)))) ((1 b) (1 d) (2 a) (2 c)))
+(test (argsort (list 3 1 2 1)) (1 3 2 0))
+(define big (sort (random-uniform 100000)))
+(test (eq? (sort big) big) 1)
+(test (car (argsort big)) 0)
+(test (median (list 5 1 4 2 3)) 3)
+(test (median (list 4 1 3 2)) 2.5)
+(test (quantile (list 1 2 3 4 5) 0.25) 2)
+(test (quantile (list 10 40 20 30 50) (list 0.9 0 0.5)) (46 10 30))
+(test (minmax (list 3 -1 7 2)) (-1 7))
+(test (histogram (list 0 1 2 3 4) 2) ((2 3) (0 2 4)))
+(test (histogram (list 0.5 1.5 1.7 9 12) (list 0 1 2 10)) ((1 2 1) (0 1 2 10)))
+(test (assoc 'skewness (describe (list 1 1 1 10))) (skewness 1.15470053837925))
 (test (distance (list 0 0) (list 3 4)) 5)
 
 ;; --- Machine Learning ---
 
-(test (kmeans (list 1 1 2 2 9 9) 2) (9 1.5))
+(define km (kmeans (list 1 1 2 2 9 9) 2))
+(test (fold + 0 (car km)) 10.5)
+(test (eq? (car (cadr km)) (last (cadr km))) 0)
+(define km (kmeans (list (list 0 0) (list 0 1) (list 10 10) (list 10 11)) 2 50 0.0001))
+(test (fold + 0 (map cadr (car km))) 11)
+;; a loose tol stops early; the assignments must still match the returned centers
+(seed 5)
+(define pts (list 0 1 2 3 4 5 6 7 8 9 10 11))
+(define km (kmeans pts 2 50 1000))
+(define closer (lambda (i) (begin
+  (define a (vector-ref (cadr km) i))
+  (define x (vector-ref pts i))
+  (<= (abs (- x (vector-ref (car km) a))) (abs (- x (vector-ref (car km) (- 1 a))))))))
+(test (fold + 0 (map closer (range 0 12))) 12)
 (test (linreg (list 1 2 3) (list 2 4 6)) (2 0))
 (test (linreg-predict (linreg (list 1 2 3) (list 2 4 6)) (list 4))  8)
+(test (linreg (list (list 1 2 3) (list 2 1 0) (list 3 3 1) (list 4 0 1) (list 5 5 2)) (list 15 5 13 8 22)) (1 2 3 1))
+(test (linreg (list 1 2 3) (list 2 4 6) 0.5) (1.6 0.8))
+(define acc (linreg-update '() (list (list 1 2 3) (list 2 1 0)) (list 15 5)))
+(linreg-update acc (list (list 3 3 1) (list 4 0 1) (list 5 5 2)) (list 13 8 22))
+(test (linreg-solve acc) (1 2 3 1))
 (test (knn (list (list 1 1) (list 5 5)) (list 0 1) (list 2 2) 2) 0)
+(test (knn (list (list 0 0) (list 0 1) (list 5 5) (list 6 5)) (list 0 0 1 1) (list (list 0.2 0.1) (list 5 6)) 1) (0 1))
+(test (linreg-predict (list 1 2 3) (list (list 1 1) (list 2 0))) (6 5))
+(test (matrix->list (pdist (list (list 0 0) (list 3 4)))) ((0 5) (5 0)))
+(test (matrix->list (cdist (list (list 0 0) (list 3 4)) (list (list 1 0) (list 0 2)) 'manhattan)) ((1 2) (6 5)))
+(test (matrix->list (cdist (list (list 1 0)) (list (list 0 2) (list 2 0)) 'cosine)) ((1 0)))
+(define idx (knn-index (list (list 1 1) (list 5 5) (list 6 5)) (list 0 1 1)))
+(test (knn-query idx (list 2 2) 1) 0)
+(test (knn-query idx (list (list 2 2) (list 5 6)) 2) (0 1))
+(test (knn-query idx (list 5 5) 2 'full) (1 (1 2) (0 1)))
+(define net (nn-init (list 2 4 3) (list "relu" "softmax")))
+(test (type net) nn)
+(test (fold + 0 (nn-predict net (list 1 2))) 1)
+(test (length (nn-predict net (list (list 1 2) (list 3 4)))) 2)
+(test (> (nn-train net (list (list 1 2) (list 3 4)) (list (list 1 0 0) (list 0 1 0)) 0.1) 0) 1)
+(test (length (nn-fit net (list (list 1 2) (list 3 4)) (list (list 1 0 0) (list 0 1 0)) 3 0.01 2 'adam)) 3)
+
+;; --- Matrices ---
+
+(define m (matrix (list (list 1 2) (list 3 4))))
+(test (matrix->list (matmul m m)) ((7 10) (15 22)))
+(test (matrix->list (transpose m)) ((1 3) (2 4)))
+(test (matvec m (list 1 1)) (3 7))
+(test (matrix->list (outer (list 1 2) (list 3 4))) ((3 4) (6 8)))
+(test (matrix->list (matrix-sub (matrix-mul m m) 1)) ((0 3) (8 15)))
+(test (matrix-shape (matrix 2 3)) (2 3))
+(test (matrix-ref m 1 0) 3)
+(test (dot m m) 30)
+(test (linreg (matrix (list (list 1) (list 2) (list 3))) (list 2 4 6)) (2 0))
 
 ; ;; --- Signal Processing ---
 
@@ -23,6 +94,21 @@
 
 (test (dot (list 1 2 3) (list 4 5 6)) 32)
 
+(test (fir (list 1 0 0 0 2) (list 0.5 0.25)) (0.5 0.25 0 0 1))
+(test (fir (list (list 1 0 0) (list 0 1 0)) (list 1 2)) ((1 2 0) (0 1 2)))
+(test (biquad (list 1 0 0 0) (list 1 0 0 -0.5 0)) (1 0.5 0.25 0.125))
+(define fs (filter-state (list (list 2 0 0 2 -1 0))))
+(test (sos-filter (list 1 0) fs) (1 0.5))
+(test (sos-filter (list 0 0) fs) (0.25 0.125))
+(test (length (resample (list 1 2 3 4 5 6 7 8 9 10) 3 2)) 15)
+(test (< (abs (- (car (drop 10 (resample (list 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1) 1 2))) 1)) 0.001) 1)
+(define g (dsp-graph 4))
+(define in (dsp-node g 'input 0))
+(define out (dsp-node g 'output 0))
+(dsp-connect g in (dsp-node g 'delay 2) (dsp-node g 'gain 0.5) out)
+(dsp-connect g in (dsp-node g 'conv (list 1 0 0 0 0 -1)) out)
+(test (dsp-render g (list 1 0 0 0 0 0 0 0 0)) ((1 0 0.5 0 0 -1 0 0 0)))
+(test (car (assoc 'block-size (dsp-bench g 10))) block-size)
 (test (ifft (pol2car (car2pol (fft (list 1 2 3 4 5 6 7 8))))) (1 2 3 4 5 6 7 8))
 
 ; ;; --- File I/O ---
@@ -31,12 +117,39 @@
 (begin
   (writewav "test.wav" (list (list 0 0 0 0)) 16 44100)
   (define x (readwav "test.wav"))
-  (test (length (car x)) 4))
+  (test (length (car x)) 4)
+  (test (stream->list (stream-map (lambda (b) (length (car b))) (stream-wav "test.wav" 3))) (3 1)))
 
 ;; write a small CSV
 (begin
   (writecsv "test.csv" (list (list 1 2 3) (list 4 5 6)))
   (define y (readcsv "test.csv"))
-  (test (length y) 2))
+  (test (length y) 2)
+  (test (stream->list (stream-csv "test.csv")) ((1 2 3) (4 5 6)))
+  (test (length (stream->list (stream-lines "test.csv"))) 2))
+
+;; numbers are written exactly
+(begin
+  (writecsv "test.csv" (list (list (/ 1 3) 1e-300 123456789.123456789)))
+  (define z (car (readcsv "test.csv")))
+  (test (* 1e20 (- (car z) (/ 1 3))) 0)
+  (test (* (car (cdr z)) 1e300) 1)
+  (test (* 1e10 (- (car (cdr (cdr z))) 123456789.123456789)) 0)
+  (writecsv "test.csv" (matrix (list (list 1 2) (list 3 4))))
+  (test (readcsv "test.csv") ((1 2) (3 4))))
+
+(begin
+  (npy-write "test.npy" (list (list 1 2 3) (list 4 5 6.5)))
+  (test (npy-read "test.npy") ((1 2 3) (4 5 6.5)))
+  (test (matrix-shape (npy-read "test.npy" 'matrix)) (2 3))
+  (npy-write "test.npy" (list 1 2 3) "i4")
+  (test (npy-read "test.npy") (1 2 3)))
+
+;; save and reload models
+(begin
+  (model-save "test.model" (linreg (list 1 2 3) (list 2 4 6)))
+  (test (model-load "test.model") (2 0))
+  (model-save "test.model" net)
+  (test (eq? (nn-predict (model-load "test.model") (list 1 2)) (nn-predict net (list 1 2))) 1))
 
 (display "\n--- Tests completed ----\n")
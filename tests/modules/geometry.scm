@@ -0,0 +1,9 @@
+;; module used by the require tests
+
+(define pi 3.141592653589793)
+(define square (lambda (x) (* x x)))
+(define circle-area (lambda (r) (* pi (square r))))
+
+(provide circle-area square)
+
+;; eof